@@ -5,14 +5,19 @@
 // managing the game loop, scene, and ECS systems.
 
 #include "app.h"
+#include <cmath>
 #include <iostream>
 #include <raylib.h>
 
+#include "fixed_timestep.h"
+#include "render/raylib_render_backend.h"
 #include "game/systems/player_input_system.h"
 #include "systems/collision_detection_system.h"
+#include "systems/flow_field_system.h"
 #include "systems/move_system.h"
 #include "systems/overlap_correction_system.h"
 #include "systems/shape_render_system.h"
+#include "systems/sleep_system.h"
 #include "systems/camera_system.h"
 #include "systems/sprite_renderer_system.h"
 
@@ -22,66 +27,100 @@
 
 
 namespace rpg {
-    APP::APP() {
+    APP::APP(const AppConfig &config) {
 #if BUILD_ATLAS_MODE
         const TexturePacker *texture_tool = new TexturePacker();
         texture_tool->packer(RESOURCE_PATH"/images/", RESOURCE_PATH"/atlas.png", RESOURCE_PATH"/atlas.json");
         delete texture_tool;
 #endif
-        SetConfigFlags(FLAG_WINDOW_RESIZABLE);
         SetTraceLogLevel(LOG_ERROR);
-        InitWindow(800, 600, "raylib + entt - collision demo");
-        //SetTargetFPS(60);
+        if (config.headless) {
+            auto null_backend = std::make_unique<NullRenderBackend>(config.headless_frames);
+            headless_backend = null_backend.get();
+            backend = std::move(null_backend);
+        } else {
+            backend = std::make_unique<RaylibRenderBackend>(800, 600, "raylib + entt - collision demo");
+        }
 
         registry = std::make_unique<entt::registry>();
         scene = std::make_unique<MyScene>(registry.get());
 
+        registry->ctx().emplace<FixedTimestep>();
+
         auto player_input_system = std::make_unique<PlayerInputSystem>(registry.get());
-        systems.push_back(std::move(player_input_system));
+        simulation_systems.push_back(std::move(player_input_system));
+
+        auto flow_field_system = std::make_unique<FlowFieldSystem>(registry.get());
+        simulation_systems.push_back(std::move(flow_field_system));
 
         auto move_system = std::make_unique<MoveSystem>(registry.get());
-        systems.push_back(std::move(move_system));
+        simulation_systems.push_back(std::move(move_system));
 
         auto collision_detection_system = std::make_unique<CollisionDetectionSystem>(registry.get());
-        systems.push_back(std::move(collision_detection_system));
+        simulation_systems.push_back(std::move(collision_detection_system));
+
+        auto sleep_system = std::make_unique<SleepSystem>(registry.get());
+        simulation_systems.push_back(std::move(sleep_system));
 
         auto overlap_correction_system = std::make_unique<OverlapCorrectionSystem>(registry.get());
-        systems.push_back(std::move(overlap_correction_system));
+        simulation_systems.push_back(std::move(overlap_correction_system));
 
-        auto camera_system = std::make_unique<CameraSystem>(registry.get());
-        camera = camera_system->get_camera();
-        systems.push_back(std::move(camera_system));
+        auto follow_camera_system = std::make_unique<CameraSystem>(registry.get(), backend.get());
+        camera = follow_camera_system->get_camera();
+        camera_system = std::move(follow_camera_system);
 
-         auto shape_render_system = std::make_unique<RenderSystem>(registry.get());
-         systems.push_back(std::move(shape_render_system));
+         auto shape_render_system = std::make_unique<RenderSystem>(registry.get(), camera, backend.get());
+         render_systems.push_back(std::move(shape_render_system));
 
-        auto sprite_render_system = std::make_unique<SpriteRendererSystem>(registry.get());
-        systems.push_back(std::move(sprite_render_system));
+        auto sprite_render_system = std::make_unique<SpriteRendererSystem>(registry.get(), camera, backend.get());
+        render_systems.push_back(std::move(sprite_render_system));
 
 
     }
 
-    APP::~APP() {
-        CloseWindow();
-    }
+    APP::~APP() = default;
 
+    // Steps the simulation systems at the fixed rate for the time the last frame took, then renders
+    // once. Time the steps could not catch up on within max_steps_per_frame is dropped.
+    // A headless run ends after its frame count and prints what the null backend recorded.
     void APP::run() const {
         scene->init();
 
-        while (!WindowShouldClose()) {
-
-
-            BeginDrawing();
-            ClearBackground(BLACK);
+        auto &fixed_timestep = registry->ctx().get<FixedTimestep>();
+        float accumulator = 0.0f;
+
+        while (!backend->should_close()) {
+            const float frame_time = backend->get_frame_time();
+            accumulator += frame_time;
+
+            fixed_timestep.steps_this_frame = 0;
+            while (accumulator >= fixed_timestep.step && fixed_timestep.steps_this_frame < fixed_timestep.max_steps_per_frame) {
+                for (const auto &system : simulation_systems) {
+                    system->run(fixed_timestep.step);
+                }
+                accumulator -= fixed_timestep.step;
+                ++fixed_timestep.steps_this_frame;
+                ++fixed_timestep.total_steps;
+            }
+            if (accumulator >= fixed_timestep.step) {
+                accumulator = std::fmod(accumulator, fixed_timestep.step);
+            }
+            fixed_timestep.alpha = accumulator / fixed_timestep.step;
 
-            BeginMode2D(*camera);
-            for (const auto &system : systems) {
-                system->run(GetFrameTime());
+            camera_system->run(frame_time);
+            backend->begin_frame(*camera);
+            for (const auto &system : render_systems) {
+                system->run(frame_time);
             }
-            EndMode2D();
-            DrawFPS(10, 10);
+            backend->end_frame();
+        }
 
-            EndDrawing();
+        if (headless_backend) {
+            const auto &stats = headless_backend->get_stats();
+            std::cout << "Headless run: " << stats.frames << " frames, " << fixed_timestep.total_steps << " steps, "
+                    << stats.quads << " quads (" << stats.rectangles << " rectangles), " << stats.vertices << " vertices, "
+                    << stats.texture_binds << " texture binds, " << stats.blend_mode_changes << " blend mode changes, "
+                    << stats.batch_flushes << " batch flushes" << std::endl;
         }
     }
 } // rpg
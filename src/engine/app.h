@@ -4,22 +4,43 @@
 
 #ifndef APP_H
 #define APP_H
+#include <cstdint>
 #include <memory>
 #include <vector>
 
 #include "raylib.h"
 #include "entt/entt.hpp"
 #include "game/scenes/my_scene.h"
+#include "render/null_render_backend.h"
+#include "render/render_backend.h"
 #include "systems/system.h"
 
 namespace rpg {
+    struct AppConfig {
+        // Runs every system against a NullRenderBackend, without a window or GPU
+        bool headless = false;
+        // Frames a headless run lasts (default: 600)
+        std::uint64_t headless_frames = 600;
+    };
+
     class APP {
-        std::unique_ptr<Scene> scene;
-        std::vector<std::unique_ptr<System>> systems;
+        // Declared first so the window outlives everything that draws to it
+        std::unique_ptr<RenderBackend> backend;
+        // Set in headless mode, to report what was recorded
+        const NullRenderBackend *headless_backend = nullptr;
+        // Declared before the systems and scene that hold signal connections to it
         std::unique_ptr<entt::registry> registry;
+        std::unique_ptr<Scene> scene;
+        // Stepped at the fixed rate of the FixedTimestep in the registry context
+        std::vector<std::unique_ptr<System>> simulation_systems;
+        // Runs once per rendered frame before drawing starts, so the renderers cull against the
+        // same camera the frame is drawn with
+        std::unique_ptr<System> camera_system;
+        // Run once per rendered frame
+        std::vector<std::unique_ptr<System>> render_systems;
         Camera2D *camera;
     public:
-        APP();
+        explicit APP(const AppConfig &config = {});
 
         ~APP();
 
@@ -0,0 +1,421 @@
+// aabb_tree_broadphase.cpp
+// Purpose: Dynamic AABB tree with surface-area-style insertion cost and AVL rotations,
+// following the classic incremental bounding volume hierarchy used by 2D physics engines.
+
+#include "aabb_tree_broadphase.h"
+
+#include <algorithm>
+
+namespace rpg {
+
+    AabbTreeBroadphase::Bounds AabbTreeBroadphase::merge(const Bounds &a, const Bounds &b) {
+        return {
+            std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y),
+            std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y)
+        };
+    }
+
+    float AabbTreeBroadphase::perimeter(const Bounds &bounds) {
+        return 2.0f * ((bounds.max_x - bounds.min_x) + (bounds.max_y - bounds.min_y));
+    }
+
+    bool AabbTreeBroadphase::contains(const Bounds &outer, const Bounds &inner) {
+        return outer.min_x <= inner.min_x && outer.min_y <= inner.min_y &&
+               outer.max_x >= inner.max_x && outer.max_y >= inner.max_y;
+    }
+
+    // Inclusive test, used to prune the tree; the exact strict test is done on the proxies
+    bool AabbTreeBroadphase::overlaps(const Bounds &a, const Bounds &b) {
+        return a.min_x <= b.max_x && a.max_x >= b.min_x &&
+               a.min_y <= b.max_y && a.max_y >= b.min_y;
+    }
+
+    std::int32_t AabbTreeBroadphase::allocate_node() {
+        std::int32_t node;
+        if (free_list != NULL_NODE) {
+            node = free_list;
+            free_list = nodes[node].parent;
+        } else {
+            node = static_cast<std::int32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+
+        nodes[node] = Node{};
+        nodes[node].height = 0;
+        return node;
+    }
+
+    void AabbTreeBroadphase::free_node(const std::int32_t node) {
+        nodes[node].parent = free_list;
+        nodes[node].height = -1;
+        free_list = node;
+    }
+
+    // Walks from `node` up to the root, rebalancing and refitting every ancestor
+    void AabbTreeBroadphase::refit_ancestors(std::int32_t node) {
+        while (node != NULL_NODE) {
+            node = balance(node);
+
+            Node &current = nodes[node];
+            const Node &left = nodes[current.left];
+            const Node &right = nodes[current.right];
+            current.height = 1 + std::max(left.height, right.height);
+            current.bounds = merge(left.bounds, right.bounds);
+
+            node = current.parent;
+        }
+    }
+
+    void AabbTreeBroadphase::insert_leaf(const std::int32_t leaf) {
+        if (root == NULL_NODE) {
+            root = leaf;
+            nodes[root].parent = NULL_NODE;
+            return;
+        }
+
+        // 1. Find the best sibling: descend while the cost of pushing the leaf down is lower
+        const Bounds leaf_bounds = nodes[leaf].bounds;
+        std::int32_t index = root;
+        while (!nodes[index].is_leaf()) {
+            const Node &node = nodes[index];
+            const float area = perimeter(node.bounds);
+            const float combined_area = perimeter(merge(node.bounds, leaf_bounds));
+
+            // Cost of creating a new parent for this node and the leaf
+            const float cost = 2.0f * combined_area;
+            // Minimum cost of pushing the leaf further down the tree
+            const float inheritance_cost = 2.0f * (combined_area - area);
+
+            auto descend_cost = [&](const std::int32_t child) {
+                const Node &child_node = nodes[child];
+                const float merged = perimeter(merge(leaf_bounds, child_node.bounds));
+                return (child_node.is_leaf() ? merged : merged - perimeter(child_node.bounds)) + inheritance_cost;
+            };
+
+            const float left_cost = descend_cost(node.left);
+            const float right_cost = descend_cost(node.right);
+
+            if (cost < left_cost && cost < right_cost) break;
+            index = left_cost < right_cost ? node.left : node.right;
+        }
+
+        // 2. Create a new parent for the sibling and the leaf
+        const std::int32_t sibling = index;
+        const std::int32_t new_parent = allocate_node();
+        const std::int32_t old_parent = nodes[sibling].parent;
+
+        nodes[new_parent].parent = old_parent;
+        nodes[new_parent].bounds = merge(leaf_bounds, nodes[sibling].bounds);
+        nodes[new_parent].height = nodes[sibling].height + 1;
+        nodes[new_parent].left = sibling;
+        nodes[new_parent].right = leaf;
+        nodes[sibling].parent = new_parent;
+        nodes[leaf].parent = new_parent;
+
+        if (old_parent == NULL_NODE) {
+            root = new_parent;
+        } else if (nodes[old_parent].left == sibling) {
+            nodes[old_parent].left = new_parent;
+        } else {
+            nodes[old_parent].right = new_parent;
+        }
+
+        // 3. Fix heights and bounds on the way back up
+        refit_ancestors(nodes[leaf].parent);
+    }
+
+    void AabbTreeBroadphase::remove_leaf(const std::int32_t leaf) {
+        if (leaf == root) {
+            root = NULL_NODE;
+            return;
+        }
+
+        const std::int32_t parent = nodes[leaf].parent;
+        const std::int32_t grand_parent = nodes[parent].parent;
+        const std::int32_t sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+        if (grand_parent == NULL_NODE) {
+            root = sibling;
+            nodes[sibling].parent = NULL_NODE;
+            free_node(parent);
+            return;
+        }
+
+        // Replace the parent with the sibling
+        if (nodes[grand_parent].left == parent) {
+            nodes[grand_parent].left = sibling;
+        } else {
+            nodes[grand_parent].right = sibling;
+        }
+        nodes[sibling].parent = grand_parent;
+        free_node(parent);
+
+        refit_ancestors(grand_parent);
+    }
+
+    // Performs a left or right rotation if node `a` is imbalanced. Returns the new subtree root.
+    std::int32_t AabbTreeBroadphase::balance(const std::int32_t a) {
+        Node &node_a = nodes[a];
+        if (node_a.is_leaf() || node_a.height < 2) return a;
+
+        const std::int32_t b = node_a.left;
+        const std::int32_t c = node_a.right;
+        Node &node_b = nodes[b];
+        Node &node_c = nodes[c];
+
+        const std::int32_t difference = node_c.height - node_b.height;
+
+        // Rotates `up` into the place of `a`, moving its taller child up with it
+        auto rotate = [&](const std::int32_t up, Node &node_up, const Node &node_stay, const bool up_is_right) {
+            const std::int32_t f = node_up.left;
+            const std::int32_t g = node_up.right;
+
+            // Swap `a` and `up`
+            node_up.left = a;
+            node_up.parent = node_a.parent;
+            node_a.parent = up;
+
+            // The old parent of `a` now points to `up`
+            if (node_up.parent == NULL_NODE) {
+                root = up;
+            } else if (nodes[node_up.parent].left == a) {
+                nodes[node_up.parent].left = up;
+            } else {
+                nodes[node_up.parent].right = up;
+            }
+
+            // The taller grandchild stays under `up`, the other one moves under `a`
+            const bool keep_f = nodes[f].height > nodes[g].height;
+            const std::int32_t kept = keep_f ? f : g;
+            const std::int32_t moved = keep_f ? g : f;
+
+            node_up.right = kept;
+            if (up_is_right) {
+                node_a.right = moved;
+            } else {
+                node_a.left = moved;
+            }
+            nodes[moved].parent = a;
+
+            node_a.bounds = merge(node_stay.bounds, nodes[moved].bounds);
+            node_up.bounds = merge(node_a.bounds, nodes[kept].bounds);
+            node_a.height = 1 + std::max(node_stay.height, nodes[moved].height);
+            node_up.height = 1 + std::max(node_a.height, nodes[kept].height);
+            return up;
+        };
+
+        // Rotate C up
+        if (difference > 1) return rotate(c, node_c, node_b, true);
+
+        // Rotate B up
+        if (difference < -1) return rotate(b, node_b, node_c, false);
+
+        return a;
+    }
+
+    // Creates, moves or refreshes the leaf of a proxy
+    void AabbTreeBroadphase::sync_leaf(const ColliderProxies &proxies, const std::uint32_t proxy) {
+        const entt::entity entity = proxies.entities[proxy];
+        const auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+        if (slot >= entity_leaves.size()) {
+            entity_leaves.resize(slot + 1, NULL_NODE);
+        }
+
+        const Bounds tight{proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy]};
+        const Bounds fat{
+            tight.min_x - AABB_MARGIN, tight.min_y - AABB_MARGIN,
+            tight.max_x + AABB_MARGIN, tight.max_y + AABB_MARGIN
+        };
+
+        std::int32_t leaf = entity_leaves[slot];
+
+        // The identifier was recycled: the stale leaf is dropped by the liveness pass
+        if (leaf != NULL_NODE && nodes[leaf].entity != entity) {
+            leaf = NULL_NODE;
+        }
+
+        if (leaf == NULL_NODE) {
+            leaf = allocate_node();
+            nodes[leaf].entity = entity;
+            nodes[leaf].bounds = fat;
+            insert_leaf(leaf);
+            entity_leaves[slot] = leaf;
+            leaves.push_back(leaf);
+        } else if (!contains(nodes[leaf].bounds, tight)) {
+            // Incremental refit: only colliders that left their fat box are re-inserted
+            remove_leaf(leaf);
+            nodes[leaf].bounds = fat;
+            insert_leaf(leaf);
+        }
+
+        Node &node = nodes[leaf];
+        node.proxy = proxy;
+        node.stamp = frame_stamp;
+        node.is_static = proxies.is_static(proxy);
+        node.is_sleeping = !node.is_static && proxies.is_passive(proxy);
+    }
+
+    void AabbTreeBroadphase::update(const ColliderProxies &proxies, const bool statics_changed, const bool sleepers_changed) {
+        ++frame_stamp;
+
+        // Static and sleeping proxies keep their leaves and indices until their own set changes
+        const std::uint32_t first = statics_changed
+                                        ? 0
+                                        : (sleepers_changed ? proxies.static_count : proxies.passive_count);
+        for (std::uint32_t proxy = first; proxy < proxies.size(); ++proxy) {
+            sync_leaf(proxies, proxy);
+        }
+
+        // Drop the leaves of colliders that were not part of this frame
+        live_leaves.clear();
+        for (const auto leaf: leaves) {
+            const Node &node = nodes[leaf];
+            if (node.stamp == frame_stamp || (node.is_static && !statics_changed) ||
+                (node.is_sleeping && !sleepers_changed)) {
+                live_leaves.push_back(leaf);
+                continue;
+            }
+
+            const auto slot = static_cast<std::size_t>(entt::to_entity(node.entity));
+            if (entity_leaves[slot] == leaf) {
+                entity_leaves[slot] = NULL_NODE;
+            }
+            remove_leaf(leaf);
+            free_node(leaf);
+        }
+        leaves.swap(live_leaves);
+    }
+
+    // Descends the tree with the tight bounds of an awake proxy. A pair of awake proxies is only
+    // reported by its lower proxy; passive (static or sleeping) proxies never query, so pairs of
+    // passive proxies are never tested. Returns the number of leaves tested.
+    std::uint64_t AabbTreeBroadphase::query_pairs(
+        const ColliderProxies &proxies,
+        const std::uint32_t proxy,
+        std::vector<ProxyPair> &pairs
+    ) const {
+        thread_local std::vector<std::int32_t> stack;
+        stack.clear();
+        if (root != NULL_NODE) stack.push_back(root);
+
+        const Bounds tight{proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy]};
+        std::uint64_t tested = 0;
+
+        while (!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (!overlaps(node.bounds, tight)) continue;
+
+            if (!node.is_leaf()) {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+                continue;
+            }
+
+            const std::uint32_t other = node.proxy;
+            if (other == proxy) continue;
+            if (!node.is_passive() && other < proxy) continue;
+
+            ++tested;
+            if (proxies.can_collide(proxy, other) && proxies.overlaps(proxy, other)) {
+                pairs.push_back(std::minmax(proxy, other));
+            }
+        }
+
+        return tested;
+    }
+
+    void AabbTreeBroadphase::find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) {
+        const std::uint32_t dynamic_offset = proxies.passive_count;
+        candidates_tested = 0;
+
+        pair_buffers.run(proxies.size() - dynamic_offset, pairs, [&](const std::size_t begin, const std::size_t end, auto &buffer) {
+            std::uint64_t tested = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                tested += query_pairs(proxies, dynamic_offset + static_cast<std::uint32_t>(i), buffer);
+            }
+            candidates_tested.fetch_add(tested, std::memory_order_relaxed);
+        });
+    }
+
+    void AabbTreeBroadphase::collect_stats(BroadphaseStats &stats) const {
+        stats.candidates_tested = candidates_tested.load(std::memory_order_relaxed);
+    }
+
+    void AabbTreeBroadphase::query_region(
+        const ColliderProxies &proxies,
+        const Rectangle &area,
+        const std::uint32_t layer_mask,
+        std::vector<std::uint32_t> &results
+    ) const {
+        thread_local std::vector<std::int32_t> stack;
+        stack.clear();
+        if (root != NULL_NODE) stack.push_back(root);
+
+        const Bounds bounds{area.x, area.y, area.x + area.width, area.y + area.height};
+
+        while (!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            if (!overlaps(node.bounds, bounds)) continue;
+
+            if (!node.is_leaf()) {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+                continue;
+            }
+
+            const std::uint32_t proxy = node.proxy;
+            if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+            if (proxies.min_x[proxy] < bounds.max_x && proxies.max_x[proxy] > bounds.min_x &&
+                proxies.min_y[proxy] < bounds.max_y && proxies.max_y[proxy] > bounds.min_y) {
+                results.push_back(proxy);
+            }
+        }
+    }
+
+    // Descends every node the ray enters before the current maximum fraction, which shrinks as
+    // the callback clips the ray
+    void AabbTreeBroadphase::raycast(
+        const ColliderProxies &proxies,
+        const RaySegment &ray,
+        const std::uint32_t layer_mask,
+        const RaycastCallback &callback
+    ) const {
+        thread_local std::vector<std::int32_t> stack;
+        stack.clear();
+        if (root != NULL_NODE) stack.push_back(root);
+
+        float max_fraction = 1.0f;
+
+        while (!stack.empty()) {
+            const Node &node = nodes[stack.back()];
+            stack.pop_back();
+
+            const Bounds &bounds = node.bounds;
+            if (intersect_ray(ray, bounds.min_x, bounds.min_y, bounds.max_x, bounds.max_y, max_fraction) < 0.0f) continue;
+
+            if (!node.is_leaf()) {
+                stack.push_back(node.left);
+                stack.push_back(node.right);
+                continue;
+            }
+
+            const std::uint32_t proxy = node.proxy;
+            if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+            const float fraction = intersect_ray(
+                ray, proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy], max_fraction
+            );
+            if (fraction < 0.0f) continue;
+
+            const float clipped = callback(proxy, fraction);
+            if (clipped < 0.0f) return;
+            max_fraction = std::min(max_fraction, clipped);
+        }
+    }
+
+} // namespace rpg
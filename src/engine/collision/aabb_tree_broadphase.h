@@ -0,0 +1,101 @@
+// aabb_tree_broadphase.h
+// Purpose: Dynamic bounding volume tree broadphase. Every collider owns a leaf with
+// a fattened AABB; a leaf is only removed and re-inserted when its collider leaves
+// the fat box, and AVL-style rotations keep the tree balanced. Queries descend the
+// tree by bounds, so any mix of collider sizes gives exact results.
+
+#ifndef AABB_TREE_BROADPHASE_H
+#define AABB_TREE_BROADPHASE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "broadphase.h"
+
+namespace rpg {
+
+    class AabbTreeBroadphase final : public Broadphase {
+        struct Bounds {
+            float min_x, min_y, max_x, max_y;
+        };
+
+        struct Node {
+            Bounds bounds;
+            // Parent node, or the next free node while the node is in the free list
+            std::int32_t parent = NULL_NODE;
+            std::int32_t left = NULL_NODE;
+            std::int32_t right = NULL_NODE;
+            // Leaves have height 0, free nodes -1
+            std::int32_t height = -1;
+            // Leaf data: the proxy index of the current frame and the owning entity
+            std::uint32_t proxy = 0;
+            entt::entity entity = entt::null;
+            std::uint32_t stamp = 0;
+            bool is_static = false;
+            bool is_sleeping = false;
+
+            [[nodiscard]] bool is_leaf() const { return left == NULL_NODE; }
+
+            [[nodiscard]] bool is_passive() const { return is_static || is_sleeping; }
+        };
+
+        std::vector<Node> nodes;
+        std::int32_t root = NULL_NODE;
+        std::int32_t free_list = NULL_NODE;
+
+        // Leaf of each entity, indexed by the entity part of its identifier
+        std::vector<std::int32_t> entity_leaves;
+        std::vector<std::int32_t> leaves;
+        std::vector<std::int32_t> live_leaves;
+        std::uint32_t frame_stamp = 0;
+
+        PairBuffers pair_buffers;
+        std::atomic<std::uint64_t> candidates_tested = 0;
+
+        std::int32_t allocate_node();
+
+        void free_node(std::int32_t node);
+
+        void insert_leaf(std::int32_t leaf);
+
+        void remove_leaf(std::int32_t leaf);
+
+        std::int32_t balance(std::int32_t node);
+
+        void refit_ancestors(std::int32_t node);
+
+        void sync_leaf(const ColliderProxies &proxies, std::uint32_t proxy);
+
+        std::uint64_t query_pairs(const ColliderProxies &proxies, std::uint32_t proxy, std::vector<ProxyPair> &pairs) const;
+
+        static Bounds merge(const Bounds &a, const Bounds &b);
+
+        static float perimeter(const Bounds &bounds);
+
+        static bool contains(const Bounds &outer, const Bounds &inner);
+
+        static bool overlaps(const Bounds &a, const Bounds &b);
+
+    public:
+        void update(const ColliderProxies &proxies, bool statics_changed, bool sleepers_changed) override;
+
+        void find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) override;
+
+        void query_region(const ColliderProxies &proxies, const Rectangle &area, std::uint32_t layer_mask,
+                          std::vector<std::uint32_t> &results) const override;
+
+        void raycast(const ColliderProxies &proxies, const RaySegment &ray, std::uint32_t layer_mask,
+                     const RaycastCallback &callback) const override;
+
+        void collect_stats(BroadphaseStats &stats) const override;
+
+    private:
+        static constexpr std::int32_t NULL_NODE = -1;
+        // Margin added around each leaf, so small moves do not touch the tree (default: 8.0f).
+        static constexpr float AABB_MARGIN = 8.0f;
+    };
+
+} // namespace rpg
+
+#endif // AABB_TREE_BROADPHASE_H
@@ -0,0 +1,61 @@
+// broadphase.cpp
+// Purpose: Creates the broadphase backend selected by BroadphaseSettings, plus the
+// ray test shared by the backends.
+
+#include "broadphase.h"
+
+#include "aabb_tree_broadphase.h"
+#include "grid_broadphase.h"
+#include "sweep_and_prune_broadphase.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rpg {
+
+    std::unique_ptr<Broadphase> make_broadphase(const BroadphaseSettings &settings) {
+        switch (settings.type) {
+            case BroadphaseType::SweepAndPrune:
+                return std::make_unique<SweepAndPruneBroadphase>();
+            case BroadphaseType::AabbTree:
+                return std::make_unique<AabbTreeBroadphase>();
+            case BroadphaseType::HashGrid:
+            default:
+                return std::make_unique<GridBroadphase>(settings.cell_size);
+        }
+    }
+
+    // Slab test: clips [0, max_fraction] against the x and y extents of the box
+    float intersect_ray(
+        const RaySegment &ray,
+        const float min_x,
+        const float min_y,
+        const float max_x,
+        const float max_y,
+        const float max_fraction
+    ) {
+        float entry_fraction = 0.0f;
+        float exit_fraction = max_fraction;
+
+        const auto clip = [&](const float origin, const float translation, const float low, const float high) {
+            if (translation == 0.0f) {
+                // Parallel to the slab: either always inside it or never
+                return origin >= low && origin <= high;
+            }
+
+            const float inverse = 1.0f / translation;
+            float slab_entry = (low - origin) * inverse;
+            float slab_exit = (high - origin) * inverse;
+            if (slab_entry > slab_exit) std::swap(slab_entry, slab_exit);
+
+            entry_fraction = std::max(entry_fraction, slab_entry);
+            exit_fraction = std::min(exit_fraction, slab_exit);
+            return entry_fraction <= exit_fraction;
+        };
+
+        if (!clip(ray.origin.x, ray.translation.x, min_x, max_x)) return -1.0f;
+        if (!clip(ray.origin.y, ray.translation.y, min_y, max_y)) return -1.0f;
+        return entry_fraction;
+    }
+
+} // namespace rpg
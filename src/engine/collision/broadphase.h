@@ -0,0 +1,180 @@
+// broadphase.h
+// Purpose: Common interface of the collision broadphase backends, plus the
+// per-chunk pair buffers they use to search for pairs in parallel.
+
+#ifndef BROADPHASE_H
+#define BROADPHASE_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "collider_proxies.h"
+
+namespace rpg {
+
+    // Pair of proxy indices, always ordered (lower, higher)
+    using ProxyPair = std::pair<std::uint32_t, std::uint32_t>;
+
+    enum class BroadphaseType {
+        HashGrid,
+        SweepAndPrune,
+        AabbTree,
+    };
+
+    // Broadphase selection, stored in the registry context so a scene can pick
+    // the strategy that suits its level layout.
+    struct BroadphaseSettings {
+        BroadphaseType type = BroadphaseType::HashGrid;
+        float cell_size = 250.0f;
+        // Lets CollisionDetectionSystem re-pick cell_size from the collider sizes of the level
+        bool auto_cell_size = true;
+    };
+
+    // Per-frame broadphase statistics, published in the registry context by CollisionDetectionSystem
+    struct BroadphaseStats {
+        // Buckets of the collider size histogram (default: 16).
+        static constexpr std::size_t SIZE_BUCKETS = 16;
+
+        std::uint32_t collider_count = 0;
+        std::uint32_t static_count = 0;
+        std::uint32_t sleeping_count = 0;
+
+        // Collider extents (the larger of width and height). Bucket `i` counts the extents in
+        // [2^(i-1), 2^i), bucket 0 those below 1 and the last one everything above.
+        std::array<std::uint32_t, SIZE_BUCKETS> size_histogram{};
+        float mean_extent = 0.0f;
+        float max_extent = 0.0f;
+
+        // Grid backend only: effective cell size, occupancy of the non-empty cells of all grids
+        // and colliders too large to be binned
+        float cell_size = 0.0f;
+        std::uint32_t occupied_cells = 0;
+        float mean_cell_occupancy = 0.0f;
+        std::uint32_t max_cell_occupancy = 0;
+        std::uint32_t oversized_count = 0;
+
+        // Bounds tests done by the pair search, and the pairs it found
+        std::uint64_t candidates_tested = 0;
+        std::uint32_t pairs_found = 0;
+
+        // Times the automatic tuning changed the cell size
+        std::uint32_t cell_size_changes = 0;
+
+        [[nodiscard]] float get_candidates_per_pair() const {
+            return static_cast<float>(candidates_tested) / static_cast<float>(std::max<std::uint32_t>(pairs_found, 1));
+        }
+    };
+
+    // Segment from `origin` to `origin + translation`; hits are reported as a fraction of it
+    struct RaySegment {
+        Vector2 origin;
+        Vector2 translation;
+    };
+
+    // Called for every proxy the ray enters before the current maximum fraction, with the entry
+    // fraction. Returns the new maximum: the current one to keep going, the hit fraction to only
+    // look for hits at least as close, or a negative value to stop. Non-owning, so the callable
+    // must outlive the raycast; wrapping a lambda neither allocates nor copies its captures.
+    class RaycastCallback {
+        void *callable;
+        float (*invoke)(void *callable, std::uint32_t proxy, float fraction);
+
+    public:
+        template<typename Callable>
+            requires (!std::is_same_v<std::remove_cvref_t<Callable>, RaycastCallback>
+                      && std::is_invocable_r_v<float, Callable &, std::uint32_t, float>)
+        RaycastCallback(Callable &&callable)
+            : callable(const_cast<void *>(static_cast<const void *>(std::addressof(callable)))),
+              invoke([](void *target, const std::uint32_t proxy, const float fraction) -> float {
+                  return (*static_cast<std::remove_reference_t<Callable> *>(target))(proxy, fraction);
+              }) {
+        }
+
+        float operator()(const std::uint32_t proxy, const float fraction) const {
+            return invoke(callable, proxy, fraction);
+        }
+    };
+
+    // Fraction at which the ray enters the box within [0, max_fraction], or a negative value if it
+    // misses. A ray starting inside the box enters it at 0.
+    float intersect_ray(const RaySegment &ray, float min_x, float min_y, float max_x, float max_y, float max_fraction);
+
+    class Broadphase {
+    public:
+        virtual ~Broadphase() = default;
+
+        // Brings the structure up to date with this frame's proxies. Static proxies are
+        // unchanged since the previous call unless `statics_changed` is set, sleeping ones
+        // unless `sleepers_changed` is set. The sleeping range follows the static one, so
+        // `statics_changed` always comes with `sleepers_changed`.
+        virtual void update(const ColliderProxies &proxies, bool statics_changed, bool sleepers_changed) = 0;
+
+        // Appends every overlapping pair except the ones between two passive (static or
+        // sleeping) proxies. Each pair is reported once, in no particular order.
+        virtual void find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) = 0;
+
+        // Appends every proxy whose layer is in `layer_mask` and whose bounds overlap `area`
+        // (with the same strict test as pairs). Safe to call from several threads at once.
+        virtual void query_region(const ColliderProxies &proxies, const Rectangle &area, std::uint32_t layer_mask,
+                                  std::vector<std::uint32_t> &results) const = 0;
+
+        // Reports every proxy whose layer is in `layer_mask` and that the ray enters, see
+        // RaycastCallback. Proxies are not reported in order of distance. Safe to call from
+        // several threads at once.
+        virtual void raycast(const ColliderProxies &proxies, const RaySegment &ray, std::uint32_t layer_mask,
+                             const RaycastCallback &callback) const = 0;
+
+        // Applies a new cell size on the next update; backends without cells ignore it
+        virtual void set_cell_size(float) {
+        }
+
+        // Fills the backend-specific fields of the stats for the last find_pairs()
+        virtual void collect_stats(BroadphaseStats &stats) const = 0;
+    };
+
+    std::unique_ptr<Broadphase> make_broadphase(const BroadphaseSettings &settings);
+
+    // One output buffer per chunk of work, so a parallel pair search needs neither
+    // locks nor a reduction. Buffers keep their capacity across frames.
+    class PairBuffers {
+        std::vector<std::vector<ProxyPair> > buffers;
+
+    public:
+        // Splits [0, count) into chunks, runs search(begin, end, buffer) on each of them in
+        // parallel and appends every buffer to `pairs`.
+        template<typename Search>
+        void run(const std::size_t count, std::vector<ProxyPair> &pairs, Search &&search) {
+            const std::size_t chunk_count = std::max<std::size_t>(1, std::thread::hardware_concurrency()) * CHUNKS_PER_THREAD;
+            buffers.resize(chunk_count);
+
+            std::for_each(
+                std::execution::par,
+                buffers.begin(),
+                buffers.end(),
+                [&](std::vector<ProxyPair> &buffer) {
+                    const auto chunk = static_cast<std::size_t>(&buffer - buffers.data());
+                    buffer.clear();
+                    search(chunk * count / chunk_count, (chunk + 1) * count / chunk_count, buffer);
+                }
+            );
+
+            for (const auto &buffer: buffers) {
+                pairs.insert(pairs.end(), buffer.begin(), buffer.end());
+            }
+        }
+
+    private:
+        // Chunks per hardware thread, to balance uneven work (default: 4).
+        static constexpr std::size_t CHUNKS_PER_THREAD = 4;
+    };
+
+} // namespace rpg
+
+#endif // BROADPHASE_H
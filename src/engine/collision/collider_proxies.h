@@ -0,0 +1,96 @@
+// collider_proxies.h
+// Purpose: Structure-of-arrays snapshot of the colliders handed to a broadphase.
+// Static colliders occupy the first `static_count` proxies and sleeping bodies the
+// ones up to `passive_count`; both ranges are kept between frames, each until its
+// own set changes. Awake dynamic colliders are appended after them every frame.
+
+#ifndef COLLIDER_PROXIES_H
+#define COLLIDER_PROXIES_H
+
+#include <cstdint>
+#include <vector>
+
+#include "entt/entt.hpp"
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    struct ColliderProxies {
+        std::vector<entt::entity> entities;
+        std::vector<float> min_x;
+        std::vector<float> min_y;
+        std::vector<float> max_x;
+        std::vector<float> max_y;
+        std::vector<std::uint32_t> layers;
+        std::vector<std::uint32_t> masks;
+        std::uint32_t static_count = 0;
+        std::uint32_t passive_count = 0;
+
+        [[nodiscard]] std::uint32_t size() const { return static_cast<std::uint32_t>(entities.size()); }
+
+        [[nodiscard]] bool is_static(const std::uint32_t proxy) const { return proxy < static_count; }
+
+        // Static or sleeping: the proxy does not move, so it is never tested against another passive one
+        [[nodiscard]] bool is_passive(const std::uint32_t proxy) const { return proxy < passive_count; }
+
+        [[nodiscard]] Vector2 center(const std::uint32_t proxy) const {
+            return {(min_x[proxy] + max_x[proxy]) * 0.5f, (min_y[proxy] + max_y[proxy]) * 0.5f};
+        }
+
+        void clear() {
+            resize(0);
+            static_count = 0;
+            passive_count = 0;
+        }
+
+        // Drops every proxy past `count`, keeping the capacity of the arrays
+        void resize(const std::uint32_t count) {
+            entities.resize(count);
+            min_x.resize(count);
+            min_y.resize(count);
+            max_x.resize(count);
+            max_y.resize(count);
+            layers.resize(count);
+            masks.resize(count);
+        }
+
+        void push_back(const entt::entity entity, const Transform &transform, const BoxCollider2D &collider) {
+            entities.push_back(entity);
+            min_x.emplace_back();
+            min_y.emplace_back();
+            max_x.emplace_back();
+            max_y.emplace_back();
+            layers.push_back(collider.layer);
+            masks.push_back(collider.mask);
+            set_bounds(size() - 1, transform, collider);
+        }
+
+        // Bounds are computed exactly like the original AABB test (min = center - size / 2,
+        // max = min + size) so overlap results stay bit-identical.
+        void set_bounds(const std::uint32_t proxy, const Transform &transform, const BoxCollider2D &collider) {
+            const float left = transform.position.x - (collider.width / 2);
+            const float top = transform.position.y - (collider.height / 2);
+
+            min_x[proxy] = left;
+            min_y[proxy] = top;
+            max_x[proxy] = left + collider.width;
+            max_y[proxy] = top + collider.height;
+        }
+
+        // Layer filter, checked before any bounds test
+        [[nodiscard]] bool can_collide(const std::uint32_t a, const std::uint32_t b) const {
+            return (layers[a] & masks[b]) != 0 && (layers[b] & masks[a]) != 0;
+        }
+
+        // Axis-Aligned Bounding Box (AABB) collision detection
+        [[nodiscard]] bool overlaps(const std::uint32_t a, const std::uint32_t b) const {
+            return min_x[a] < max_x[b] &&
+                   max_x[a] > min_x[b] &&
+                   min_y[a] < max_y[b] &&
+                   max_y[a] > min_y[b];
+        }
+    };
+
+} // namespace rpg
+
+#endif // COLLIDER_PROXIES_H
@@ -0,0 +1,77 @@
+// contact_stream.cpp
+// Purpose: Builds the per-entity contact ranges and diffs consecutive frames into events.
+
+#include "contact_stream.h"
+
+#include <algorithm>
+
+namespace rpg {
+
+    void ContactStream::publish(std::vector<EntityPair> &sorted_pairs) {
+        previous_pairs.swap(pairs);
+        pairs.swap(sorted_pairs);
+        sorted_pairs.clear();
+
+        build_contacts();
+        build_events();
+    }
+
+    // Stores each pair in both directions, sorted by entity, and records where each entity's contacts start
+    void ContactStream::build_contacts() {
+        // Only the entities with contacts last frame have a range to clear
+        for (const auto &contact: contacts) {
+            ranges[entt::to_entity(contact.entity)] = {};
+        }
+
+        contacts.clear();
+        for (const auto &[entity_a, entity_b]: pairs) {
+            contacts.push_back({entity_a, entity_b});
+            contacts.push_back({entity_b, entity_a});
+        }
+
+        std::sort(contacts.begin(), contacts.end(), [](const Contact &a, const Contact &b) {
+            return a.entity != b.entity ? a.entity < b.entity : a.other < b.other;
+        });
+
+        for (std::uint32_t i = 0; i < contacts.size(); ++i) {
+            const auto slot = static_cast<std::size_t>(entt::to_entity(contacts[i].entity));
+            if (slot >= ranges.size()) {
+                ranges.resize(slot + 1);
+            }
+
+            Range &range = ranges[slot];
+            if (range.count == 0) range.begin = i;
+            ++range.count;
+        }
+    }
+
+    // Merges the sorted pair lists of the previous and the current frame
+    void ContactStream::build_events() {
+        events.clear();
+
+        auto previous = previous_pairs.begin();
+        auto current = pairs.begin();
+        while (previous != previous_pairs.end() || current != pairs.end()) {
+            if (current == pairs.end() || (previous != previous_pairs.end() && *previous < *current)) {
+                events.push_back({*previous++, ContactEventType::End});
+            } else if (previous == previous_pairs.end() || *current < *previous) {
+                events.push_back({*current++, ContactEventType::Begin});
+            } else {
+                events.push_back({*current++, ContactEventType::Stay});
+                ++previous;
+            }
+        }
+    }
+
+    std::span<const Contact> ContactStream::get_contacts(const entt::entity entity) const {
+        const auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+        if (slot >= ranges.size() || ranges[slot].count == 0) return {};
+
+        // The slot may belong to another version of the identifier
+        const Range &range = ranges[slot];
+        if (contacts[range.begin].entity != entity) return {};
+
+        return {contacts.data() + range.begin, range.count};
+    }
+
+} // namespace rpg
@@ -0,0 +1,78 @@
+// contact_stream.h
+// Purpose: Frame-level contact buffer published by CollisionDetectionSystem in the
+// registry context. Contacts are stored once per frame in contiguous arrays sorted
+// by entity, with a per-entity range lookup, and begin/stay/end events are found by
+// diffing the sorted pair lists of two consecutive frames.
+
+#ifndef CONTACT_STREAM_H
+#define CONTACT_STREAM_H
+
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "entt/entt.hpp"
+
+namespace rpg {
+
+    // Pair of colliding entities, always ordered (lower, higher)
+    using EntityPair = std::pair<entt::entity, entt::entity>;
+
+    // One side of a pair: `other` touches `entity`. Every pair is stored in both directions.
+    struct Contact {
+        entt::entity entity;
+        entt::entity other;
+    };
+
+    enum class ContactEventType : std::uint8_t {
+        Begin,
+        Stay,
+        End,
+    };
+
+    struct ContactEvent {
+        EntityPair pair;
+        ContactEventType type;
+    };
+
+    class ContactStream {
+        struct Range {
+            std::uint32_t begin = 0;
+            std::uint32_t count = 0;
+        };
+
+        std::vector<EntityPair> pairs;
+        std::vector<EntityPair> previous_pairs;
+        std::vector<Contact> contacts;
+        std::vector<ContactEvent> events;
+
+        // Contact range of each entity, indexed by the entity part of its identifier
+        std::vector<Range> ranges;
+
+        void build_contacts();
+
+        void build_events();
+
+    public:
+        // Replaces the current contacts with `sorted_pairs` (unique, each ordered (lower, higher) and
+        // sorted) and computes the events against the previous frame. The vector is swapped in, and
+        // gets the storage of an older frame back so the caller can reuse it.
+        void publish(std::vector<EntityPair> &sorted_pairs);
+
+        // Every pair of the current frame, sorted
+        [[nodiscard]] std::span<const EntityPair> get_pairs() const { return pairs; }
+
+        // Contacts of one entity, sorted by the other entity
+        [[nodiscard]] std::span<const Contact> get_contacts(entt::entity entity) const;
+
+        [[nodiscard]] bool is_colliding(const entt::entity entity) const { return !get_contacts(entity).empty(); }
+
+        // Begin/stay/end events of the current frame, sorted by pair. End events may refer to
+        // entities destroyed since the previous frame.
+        [[nodiscard]] std::span<const ContactEvent> get_events() const { return events; }
+    };
+
+} // namespace rpg
+
+#endif // CONTACT_STREAM_H
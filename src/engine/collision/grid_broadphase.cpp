@@ -0,0 +1,463 @@
+// grid_broadphase.cpp
+// Purpose: Pair search over the static, sleeping and dynamic CSR grids. Colliders are binned
+// by their center, so a 3x3 neighborhood finds every overlap between colliders no
+// larger than a cell; larger ones are searched by their bounds.
+
+#include "grid_broadphase.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace rpg {
+
+    GridBroadphase::PassiveGrid::PassiveGrid(const float cell_size): grid(cell_size) {
+    }
+
+    GridBroadphase::GridBroadphase(const float cell_size)
+        : statics(cell_size), sleepers(cell_size), dynamic_grid(cell_size) {
+    }
+
+    // A proxy wider or taller than the requested cell size could overlap proxies outside of its 3x3
+    // neighborhood. The effective cell size is never smaller, so everything else fits.
+    bool GridBroadphase::is_oversized(const ColliderProxies &proxies, const std::uint32_t proxy) const {
+        const float cell_size = dynamic_grid.get_cell_size();
+        return proxies.max_x[proxy] - proxies.min_x[proxy] > cell_size ||
+               proxies.max_y[proxy] - proxies.min_y[proxy] > cell_size;
+    }
+
+    // Bins the proxies in [begin, end) into a passive grid from scratch
+    void GridBroadphase::build_passive(
+        PassiveGrid &passive,
+        const ColliderProxies &proxies,
+        const std::uint32_t begin,
+        const std::uint32_t end
+    ) const {
+        passive.centers.clear();
+        passive.proxies.clear();
+        passive.oversized.clear();
+        for (std::uint32_t proxy = begin; proxy < end; ++proxy) {
+            if (is_oversized(proxies, proxy)) {
+                passive.oversized.push_back(proxy);
+                continue;
+            }
+            passive.centers.push_back(proxies.center(proxy));
+            passive.proxies.push_back(proxy);
+        }
+        passive.grid.build(passive.centers);
+    }
+
+    void GridBroadphase::update(const ColliderProxies &proxies, const bool statics_changed, const bool sleepers_changed) {
+        // A new cell size changes which passive proxies are oversized, even if they did not change
+        if (statics_changed || rebuild_passive) {
+            build_passive(statics, proxies, 0, proxies.static_count);
+        }
+        if (sleepers_changed || rebuild_passive) {
+            build_passive(sleepers, proxies, proxies.static_count, proxies.passive_count);
+        }
+        rebuild_passive = false;
+
+        // Dynamic proxies are renumbered every frame, their grid items are not
+        std::ranges::fill(dynamic_proxies, NO_PROXY);
+        dynamic_oversized.clear();
+        for (std::uint32_t proxy = proxies.passive_count; proxy < proxies.size(); ++proxy) {
+            if (is_oversized(proxies, proxy)) {
+                dynamic_oversized.push_back(proxy);
+                continue;
+            }
+            const std::uint32_t item = acquire_item(proxies.entities[proxy]);
+            dynamic_centers[item] = proxies.center(proxy);
+            dynamic_proxies[item] = proxy;
+        }
+
+        for (std::uint32_t item = 0; item < item_entities.size(); ++item) {
+            if (dynamic_proxies[item] == NO_PROXY && item_entities[item] != entt::null) {
+                release_item(item);
+            }
+        }
+        dynamic_grid.update(dynamic_centers);
+    }
+
+    // Grid item of a dynamic collider, kept while it stays a binned dynamic proxy
+    std::uint32_t GridBroadphase::acquire_item(const entt::entity entity) {
+        const auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+        if (slot >= entity_items.size()) {
+            entity_items.resize(slot + 1, NO_ITEM);
+        }
+
+        std::uint32_t item = entity_items[slot];
+        if (item != NO_ITEM && item_entities[item] == entity) return item;
+
+        if (!free_items.empty()) {
+            item = free_items.back();
+            free_items.pop_back();
+        } else {
+            item = static_cast<std::uint32_t>(item_entities.size());
+            item_entities.push_back(entt::null);
+            dynamic_centers.emplace_back();
+            dynamic_proxies.push_back(NO_PROXY);
+        }
+
+        item_entities[item] = entity;
+        entity_items[slot] = item;
+        return item;
+    }
+
+    // A NaN center takes the item out of the dynamic grid until it is reused
+    void GridBroadphase::release_item(const std::uint32_t item) {
+        const auto slot = static_cast<std::size_t>(entt::to_entity(item_entities[item]));
+        if (entity_items[slot] == item) {
+            entity_items[slot] = NO_ITEM;
+        }
+
+        constexpr float nan = std::numeric_limits<float>::quiet_NaN();
+        dynamic_centers[item] = {nan, nan};
+        item_entities[item] = entt::null;
+        free_items.push_back(item);
+    }
+
+    // Gathers the proxies of every cell of `grid` within one cell of `area` into batch. For an area
+    // that is a cell of the same grid this is exactly its 3x3 neighborhood.
+    void GridBroadphase::gather_candidates(
+        const SpatialGrid &grid,
+        const std::span<const std::uint32_t> grid_proxies,
+        const Rectangle &area,
+        const ColliderProxies &proxies,
+        CandidateBatch &batch
+    ) {
+        batch.clear();
+        grid.for_each_item(area, 1, [&](const std::uint32_t item) {
+            batch.push_back(proxies, grid_proxies[item]);
+        });
+    }
+
+    // Checks the dynamic proxies of a cell against their neighborhood in every grid. Every proxy of
+    // the cell shares the same neighborhood, so candidates are gathered once into SoA batches and
+    // tested with the SIMD narrowphase. A dynamic pair is only reported by its lower proxy, so every
+    // pair is found exactly once; passive proxies never look for pairs themselves. Returns the number
+    // of candidate tests.
+    std::uint64_t GridBroadphase::check_cell(
+        const ColliderProxies &proxies,
+        const std::uint32_t cell_index,
+        std::vector<ProxyPair> &pairs
+    ) const {
+        thread_local CandidateBatch dynamic_candidates;
+        thread_local CandidateBatch static_candidates;
+        thread_local CandidateBatch sleeping_candidates;
+        thread_local std::vector<std::uint32_t> hits;
+
+        const Rectangle cell_rect = dynamic_grid.get_cell_rect(cell_index);
+        gather_candidates(dynamic_grid, dynamic_proxies, cell_rect, proxies, dynamic_candidates);
+        gather_candidates(statics.grid, statics.proxies, cell_rect, proxies, static_candidates);
+        gather_candidates(sleepers.grid, sleepers.proxies, cell_rect, proxies, sleeping_candidates);
+        hits.resize(std::max({dynamic_candidates.size(), static_candidates.size(), sleeping_candidates.size()}));
+
+        const auto cell_items = dynamic_grid.get_cell_items(cell_index);
+        for (const auto item_a: cell_items) {
+            const std::uint32_t proxy_a = dynamic_proxies[item_a];
+
+            const std::uint32_t dynamic_hits = overlap_batch(proxies, proxy_a, dynamic_candidates, hits.data());
+            for (std::uint32_t i = 0; i < dynamic_hits; ++i) {
+                const std::uint32_t proxy_b = dynamic_candidates.proxies[hits[i]];
+                // Skips self-collision and pairs owned by the other proxy
+                if (proxy_b <= proxy_a) continue;
+                pairs.emplace_back(proxy_a, proxy_b);
+            }
+
+            // Passive proxies come first, so they are always the lower proxy of the pair
+            for (const auto *passive_candidates: {&static_candidates, &sleeping_candidates}) {
+                const std::uint32_t passive_hits = overlap_batch(proxies, proxy_a, *passive_candidates, hits.data());
+                for (std::uint32_t i = 0; i < passive_hits; ++i) {
+                    pairs.emplace_back(passive_candidates->proxies[hits[i]], proxy_a);
+                }
+            }
+        }
+
+        return cell_items.size() * (static_cast<std::uint64_t>(dynamic_candidates.size()) +
+                                    static_candidates.size() + sleeping_candidates.size());
+    }
+
+    // Checks an oversized proxy against the binned proxies that its bounds reach, and against the
+    // other oversized proxies. Binned proxies never see oversized ones, so these pairs are always
+    // reported from here; passive proxies only look for dynamic binned ones. Returns the number of
+    // candidate tests.
+    std::uint64_t GridBroadphase::check_oversized(
+        const ColliderProxies &proxies,
+        const std::uint32_t proxy,
+        std::vector<ProxyPair> &pairs
+    ) const {
+        thread_local CandidateBatch candidates;
+        thread_local std::vector<std::uint32_t> hits;
+
+        const Rectangle bounds{
+            proxies.min_x[proxy], proxies.min_y[proxy],
+            proxies.max_x[proxy] - proxies.min_x[proxy], proxies.max_y[proxy] - proxies.min_y[proxy]
+        };
+        const bool is_passive = proxies.is_passive(proxy);
+        std::uint64_t tested = 0;
+
+        auto test_grid = [&](const SpatialGrid &grid, const std::span<const std::uint32_t> grid_proxies) {
+            gather_candidates(grid, grid_proxies, bounds, proxies, candidates);
+            hits.resize(candidates.size());
+            tested += candidates.size();
+
+            const std::uint32_t hit_count = overlap_batch(proxies, proxy, candidates, hits.data());
+            for (std::uint32_t i = 0; i < hit_count; ++i) {
+                pairs.push_back(std::minmax(proxy, candidates.proxies[hits[i]]));
+            }
+        };
+
+        test_grid(dynamic_grid, dynamic_proxies);
+        if (is_passive) return tested;
+        test_grid(statics.grid, statics.proxies);
+        test_grid(sleepers.grid, sleepers.proxies);
+
+        // Oversized dynamic pairs are owned by the lower proxy, passive ones by the dynamic proxy
+        for (const auto other: dynamic_oversized) {
+            if (other <= proxy) continue;
+            ++tested;
+            if (proxies.can_collide(proxy, other) && proxies.overlaps(proxy, other)) {
+                pairs.emplace_back(proxy, other);
+            }
+        }
+        for (const auto *passive_oversized: {&statics.oversized, &sleepers.oversized}) {
+            for (const auto other: *passive_oversized) {
+                ++tested;
+                if (proxies.can_collide(proxy, other) && proxies.overlaps(proxy, other)) {
+                    pairs.emplace_back(other, proxy);
+                }
+            }
+        }
+
+        return tested;
+    }
+
+    void GridBroadphase::find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) {
+        candidates_tested = 0;
+
+        const auto occupied_cells = dynamic_grid.get_occupied_cells();
+        pair_buffers.run(occupied_cells.size(), pairs, [&](const std::size_t begin, const std::size_t end, auto &buffer) {
+            std::uint64_t tested = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                tested += check_cell(proxies, occupied_cells[i], buffer);
+            }
+            candidates_tested.fetch_add(tested, std::memory_order_relaxed);
+        });
+
+        const std::size_t static_count = statics.oversized.size();
+        const std::size_t passive_count = static_count + sleepers.oversized.size();
+        if (passive_count + dynamic_oversized.size() == 0) return;
+
+        pair_buffers.run(passive_count + dynamic_oversized.size(), pairs, [&](const std::size_t begin, const std::size_t end, auto &buffer) {
+            std::uint64_t tested = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                const std::uint32_t proxy = i < static_count
+                                                ? statics.oversized[i]
+                                                : (i < passive_count
+                                                       ? sleepers.oversized[i - static_count]
+                                                       : dynamic_oversized[i - passive_count]);
+                tested += check_oversized(proxies, proxy, buffer);
+            }
+            candidates_tested.fetch_add(tested, std::memory_order_relaxed);
+        });
+    }
+
+    void GridBroadphase::query_region(
+        const ColliderProxies &proxies,
+        const Rectangle &area,
+        const std::uint32_t layer_mask,
+        std::vector<std::uint32_t> &results
+    ) const {
+        thread_local CandidateBatch candidates;
+        thread_local std::vector<std::uint32_t> hits;
+
+        const OverlapQuery query{
+            area.x, area.y, area.x + area.width, area.y + area.height,
+            BoxCollider2D::ALL_LAYERS, layer_mask
+        };
+
+        auto query_grid = [&](const SpatialGrid &grid, const std::span<const std::uint32_t> grid_proxies) {
+            gather_candidates(grid, grid_proxies, area, proxies, candidates);
+            hits.resize(candidates.size());
+
+            const std::uint32_t hit_count = overlap_batch(query, candidates, hits.data());
+            for (std::uint32_t i = 0; i < hit_count; ++i) {
+                results.push_back(candidates.proxies[hits[i]]);
+            }
+        };
+
+        query_grid(statics.grid, statics.proxies);
+        query_grid(sleepers.grid, sleepers.proxies);
+        query_grid(dynamic_grid, dynamic_proxies);
+
+        for (const auto *oversized: {&statics.oversized, &sleepers.oversized, &dynamic_oversized}) {
+            for (const auto proxy: *oversized) {
+                if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+                if (proxies.min_x[proxy] < query.max_x && proxies.max_x[proxy] > query.min_x &&
+                    proxies.min_y[proxy] < query.max_y && proxies.max_y[proxy] > query.min_y) {
+                    results.push_back(proxy);
+                }
+            }
+        }
+    }
+
+    // Walks the cells crossed by the ray with a DDA. Colliders are binned by their center and reach
+    // into the neighboring cells, so the 3x3 window around the current cell is visited. The walk is
+    // monotone and 4-connected: each step only adds one new row or column of three cells, so every
+    // cell, and every proxy, is visited once.
+    void GridBroadphase::raycast_grid(
+        const SpatialGrid &grid,
+        const std::span<const std::uint32_t> grid_proxies,
+        const ColliderProxies &proxies,
+        const RaySegment &ray,
+        const std::uint32_t layer_mask,
+        const RaycastCallback &callback,
+        float &max_fraction
+    ) {
+        constexpr float infinity = std::numeric_limits<float>::infinity();
+
+        const int columns = grid.get_columns();
+        const int rows = grid.get_rows();
+        if (columns == 0 || rows == 0) return;
+
+        // Start where the ray enters the grid grown by one cell; nothing outside of it can be hit
+        const float size = grid.get_effective_cell_size();
+        const Rectangle bounds = grid.get_bounds();
+        const float start = intersect_ray(
+            ray,
+            bounds.x - size, bounds.y - size,
+            bounds.x + bounds.width + size, bounds.y + bounds.height + size,
+            max_fraction
+        );
+        if (start < 0.0f) return;
+
+        // Returns false once the callback asked to stop
+        auto visit_cell = [&](const int column, const int row) {
+            for (const auto item: grid.get_cell_items(column, row)) {
+                const std::uint32_t proxy = grid_proxies[item];
+                if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+                const float fraction = intersect_ray(
+                    ray, proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy],
+                    max_fraction
+                );
+                if (fraction < 0.0f) continue;
+
+                const float clipped = callback(proxy, fraction);
+                if (clipped < 0.0f) {
+                    max_fraction = clipped;
+                    return false;
+                }
+                max_fraction = std::min(max_fraction, clipped);
+            }
+            return true;
+        };
+
+        auto [column, row] = grid.get_cell(ray.origin.x + ray.translation.x * start, ray.origin.y + ray.translation.y * start);
+        for (int window_row = row - 1; window_row <= row + 1; window_row++) {
+            for (int window_column = column - 1; window_column <= column + 1; window_column++) {
+                if (!visit_cell(window_column, window_row)) return;
+            }
+        }
+
+        const int step_x = ray.translation.x > 0.0f ? 1 : (ray.translation.x < 0.0f ? -1 : 0);
+        const int step_y = ray.translation.y > 0.0f ? 1 : (ray.translation.y < 0.0f ? -1 : 0);
+
+        // Fractions at which the ray crosses the next column and row boundaries, and between boundaries
+        const float delta_x = step_x != 0 ? size / std::abs(ray.translation.x) : infinity;
+        const float delta_y = step_y != 0 ? size / std::abs(ray.translation.y) : infinity;
+        float next_x = step_x != 0
+                           ? (bounds.x + static_cast<float>(column + (step_x > 0)) * size - ray.origin.x) / ray.translation.x
+                           : infinity;
+        float next_y = step_y != 0
+                           ? (bounds.y + static_cast<float>(row + (step_y > 0)) * size - ray.origin.y) / ray.translation.y
+                           : infinity;
+
+        while (std::min(next_x, next_y) <= max_fraction) {
+            if (next_x < next_y) {
+                column += step_x;
+                next_x += delta_x;
+                for (int window_row = row - 1; window_row <= row + 1; window_row++) {
+                    if (!visit_cell(column + step_x, window_row)) return;
+                }
+            } else {
+                row += step_y;
+                next_y += delta_y;
+                for (int window_column = column - 1; window_column <= column + 1; window_column++) {
+                    if (!visit_cell(window_column, row + step_y)) return;
+                }
+            }
+
+            // Past the grid in the direction of travel: no cell ahead can hold a proxy
+            if ((step_x > 0 && column > columns) || (step_x < 0 && column < -1) ||
+                (step_y > 0 && row > rows) || (step_y < 0 && row < -1)) {
+                return;
+            }
+        }
+    }
+
+    void GridBroadphase::raycast(
+        const ColliderProxies &proxies,
+        const RaySegment &ray,
+        const std::uint32_t layer_mask,
+        const RaycastCallback &callback
+    ) const {
+        float max_fraction = 1.0f;
+        raycast_grid(statics.grid, statics.proxies, proxies, ray, layer_mask, callback, max_fraction);
+        if (max_fraction < 0.0f) return;
+        raycast_grid(sleepers.grid, sleepers.proxies, proxies, ray, layer_mask, callback, max_fraction);
+        if (max_fraction < 0.0f) return;
+        raycast_grid(dynamic_grid, dynamic_proxies, proxies, ray, layer_mask, callback, max_fraction);
+        if (max_fraction < 0.0f) return;
+
+        for (const auto *oversized: {&statics.oversized, &sleepers.oversized, &dynamic_oversized}) {
+            for (const auto proxy: *oversized) {
+                if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+                const float fraction = intersect_ray(
+                    ray, proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy],
+                    max_fraction
+                );
+                if (fraction < 0.0f) continue;
+
+                const float clipped = callback(proxy, fraction);
+                if (clipped < 0.0f) return;
+                max_fraction = std::min(max_fraction, clipped);
+            }
+        }
+    }
+
+    void GridBroadphase::set_cell_size(const float cell_size) {
+        statics.grid.set_cell_size(cell_size);
+        sleepers.grid.set_cell_size(cell_size);
+        dynamic_grid.set_cell_size(cell_size);
+        rebuild_passive = true;
+    }
+
+    void GridBroadphase::collect_stats(BroadphaseStats &stats) const {
+        stats.cell_size = dynamic_grid.get_effective_cell_size();
+        stats.oversized_count = static_cast<std::uint32_t>(
+            statics.oversized.size() + sleepers.oversized.size() + dynamic_oversized.size());
+        stats.candidates_tested = candidates_tested.load(std::memory_order_relaxed);
+
+        std::uint32_t occupied_cells = 0;
+        std::uint64_t binned_items = 0;
+        std::uint32_t max_occupancy = 0;
+        for (const auto *grid: {&statics.grid, &sleepers.grid, &dynamic_grid}) {
+            for (const auto cell: grid->get_occupied_cells()) {
+                const auto occupancy = static_cast<std::uint32_t>(grid->get_cell_items(cell).size());
+                ++occupied_cells;
+                binned_items += occupancy;
+                max_occupancy = std::max(max_occupancy, occupancy);
+            }
+        }
+
+        stats.occupied_cells = occupied_cells;
+        stats.max_cell_occupancy = max_occupancy;
+        stats.mean_cell_occupancy = occupied_cells > 0
+                                        ? static_cast<float>(binned_items) / static_cast<float>(occupied_cells)
+                                        : 0.0f;
+    }
+
+} // namespace rpg
@@ -0,0 +1,104 @@
+// grid_broadphase.h
+// Purpose: Uniform grid broadphase. Static proxies live in a CSR grid that is only
+// rebuilt when the static set changes, and sleeping bodies in a second one rebuilt
+// only when a body falls asleep or wakes up; every awake collider keeps its own grid
+// item across frames, so the dynamic grid only moves the items that changed cell.
+// Colliders larger than a cell do not fit the 3x3 neighborhood search and are
+// kept in separate oversized lists.
+
+#ifndef GRID_BROADPHASE_H
+#define GRID_BROADPHASE_H
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "broadphase.h"
+#include "narrowphase.h"
+#include "spatial_grid.h"
+
+namespace rpg {
+
+    class GridBroadphase final : public Broadphase {
+        // Proxies of one passive range, binned once per change of the range
+        struct PassiveGrid {
+            SpatialGrid grid;
+            std::vector<Vector2> centers;
+            // Proxy of each grid item
+            std::vector<std::uint32_t> proxies;
+            // Proxies larger than a cell, tested against the grids by their bounds instead of being binned
+            std::vector<std::uint32_t> oversized;
+
+            explicit PassiveGrid(float cell_size);
+        };
+
+        PassiveGrid statics;
+        PassiveGrid sleepers;
+
+        SpatialGrid dynamic_grid;
+        std::vector<Vector2> dynamic_centers;
+
+        // Proxy of each dynamic grid item; NO_PROXY for a free item
+        std::vector<std::uint32_t> dynamic_proxies;
+
+        // Dynamic grid item of each entity, indexed by entity slot, and the entity holding each item
+        std::vector<std::uint32_t> entity_items;
+        std::vector<entt::entity> item_entities;
+        std::vector<std::uint32_t> free_items;
+
+        // Awake proxies larger than a cell
+        std::vector<std::uint32_t> dynamic_oversized;
+
+        // Set by a cell size change, which reclassifies the passive proxies
+        bool rebuild_passive = false;
+
+        PairBuffers pair_buffers;
+        std::atomic<std::uint64_t> candidates_tested = 0;
+
+        [[nodiscard]] bool is_oversized(const ColliderProxies &proxies, std::uint32_t proxy) const;
+
+        void build_passive(PassiveGrid &passive, const ColliderProxies &proxies, std::uint32_t begin, std::uint32_t end) const;
+
+        std::uint32_t acquire_item(entt::entity entity);
+
+        void release_item(std::uint32_t item);
+
+        static void gather_candidates(const SpatialGrid &grid, std::span<const std::uint32_t> grid_proxies,
+                                      const Rectangle &area, const ColliderProxies &proxies, CandidateBatch &batch);
+
+        std::uint64_t check_cell(const ColliderProxies &proxies, std::uint32_t cell_index,
+                                 std::vector<ProxyPair> &pairs) const;
+
+        std::uint64_t check_oversized(const ColliderProxies &proxies, std::uint32_t proxy,
+                                      std::vector<ProxyPair> &pairs) const;
+
+        static void raycast_grid(const SpatialGrid &grid, std::span<const std::uint32_t> grid_proxies,
+                                 const ColliderProxies &proxies, const RaySegment &ray, std::uint32_t layer_mask,
+                                 const RaycastCallback &callback, float &max_fraction);
+
+    public:
+        explicit GridBroadphase(float cell_size);
+
+        void update(const ColliderProxies &proxies, bool statics_changed, bool sleepers_changed) override;
+
+        void find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) override;
+
+        void query_region(const ColliderProxies &proxies, const Rectangle &area, std::uint32_t layer_mask,
+                          std::vector<std::uint32_t> &results) const override;
+
+        void raycast(const ColliderProxies &proxies, const RaySegment &ray, std::uint32_t layer_mask,
+                     const RaycastCallback &callback) const override;
+
+        void set_cell_size(float cell_size) override;
+
+        void collect_stats(BroadphaseStats &stats) const override;
+
+    private:
+        static constexpr std::uint32_t NO_PROXY = 0xFFFFFFFFu;
+        static constexpr std::uint32_t NO_ITEM = 0xFFFFFFFFu;
+    };
+
+} // namespace rpg
+
+#endif // GRID_BROADPHASE_H
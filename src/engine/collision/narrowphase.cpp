@@ -0,0 +1,195 @@
+// narrowphase.cpp
+// Purpose: Scalar, SSE, AVX2 and AVX-512 overlap kernels with runtime dispatch.
+// Every kernel applies the layer filter and uses ordered strict comparisons, so
+// all of them report exactly the same hits as the scalar test.
+
+#include "narrowphase.h"
+
+#include <bit>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define RPG_NARROWPHASE_SSE 1
+#include <immintrin.h>
+#endif
+
+// GCC on Win64 does not realign the stack past 16 bytes (GCC bug 54412), yet may spill
+// __m256/__m512 values with aligned moves, so MinGW builds keep to the SSE kernel
+#if RPG_NARROWPHASE_SSE && (defined(__GNUC__) || defined(__clang__)) && \
+    !(defined(_WIN32) && defined(__GNUC__) && !defined(__clang__))
+#define RPG_NARROWPHASE_DISPATCH 1
+#endif
+
+namespace rpg {
+
+    namespace {
+        using Kernel = std::uint32_t (*)(const OverlapQuery &query, const CandidateBatch &batch,
+                                         std::uint32_t begin, std::uint32_t *hits);
+
+        // Tests candidates [begin, size) one at a time; also handles the tails of the SIMD kernels
+        std::uint32_t overlap_scalar(const OverlapQuery &query, const CandidateBatch &batch,
+                                     const std::uint32_t begin, std::uint32_t *hits) {
+            std::uint32_t hit_count = 0;
+            for (std::uint32_t i = begin; i < batch.size(); ++i) {
+                if ((query.layer & batch.masks[i]) != 0 &&
+                    (batch.layers[i] & query.mask) != 0 &&
+                    query.min_x < batch.max_x[i] &&
+                    query.max_x > batch.min_x[i] &&
+                    query.min_y < batch.max_y[i] &&
+                    query.max_y > batch.min_y[i]) {
+                    hits[hit_count++] = i;
+                }
+            }
+            return hit_count;
+        }
+
+        // Appends the lane indices set in `mask`, offset by the first candidate of the block
+        inline std::uint32_t append_hits(unsigned mask, const std::uint32_t base, std::uint32_t *hits) {
+            std::uint32_t hit_count = 0;
+            while (mask != 0) {
+                hits[hit_count++] = base + static_cast<std::uint32_t>(std::countr_zero(mask));
+                mask &= mask - 1;
+            }
+            return hit_count;
+        }
+
+#if RPG_NARROWPHASE_SSE
+        std::uint32_t overlap_sse(const OverlapQuery &query, const CandidateBatch &batch,
+                                  const std::uint32_t begin, std::uint32_t *hits) {
+            const __m128 query_min_x = _mm_set1_ps(query.min_x);
+            const __m128 query_min_y = _mm_set1_ps(query.min_y);
+            const __m128 query_max_x = _mm_set1_ps(query.max_x);
+            const __m128 query_max_y = _mm_set1_ps(query.max_y);
+            const __m128i query_layer = _mm_set1_epi32(static_cast<int>(query.layer));
+            const __m128i query_mask = _mm_set1_epi32(static_cast<int>(query.mask));
+            const __m128i zero = _mm_setzero_si128();
+
+            std::uint32_t hit_count = 0;
+            std::uint32_t i = begin;
+            for (; i + 4 <= batch.size(); i += 4) {
+                const auto *layers = reinterpret_cast<const __m128i *>(batch.layers.data() + i);
+                const auto *masks = reinterpret_cast<const __m128i *>(batch.masks.data() + i);
+                const __m128i filtered = _mm_or_si128(
+                    _mm_cmpeq_epi32(_mm_and_si128(query_layer, _mm_loadu_si128(masks)), zero),
+                    _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128(layers), query_mask), zero));
+
+                const __m128 overlap = _mm_and_ps(
+                    _mm_and_ps(
+                        _mm_cmplt_ps(query_min_x, _mm_loadu_ps(batch.max_x.data() + i)),
+                        _mm_cmpgt_ps(query_max_x, _mm_loadu_ps(batch.min_x.data() + i))),
+                    _mm_and_ps(
+                        _mm_cmplt_ps(query_min_y, _mm_loadu_ps(batch.max_y.data() + i)),
+                        _mm_cmpgt_ps(query_max_y, _mm_loadu_ps(batch.min_y.data() + i))));
+
+                const __m128 accepted = _mm_andnot_ps(_mm_castsi128_ps(filtered), overlap);
+                hit_count += append_hits(static_cast<unsigned>(_mm_movemask_ps(accepted)), i, hits + hit_count);
+            }
+
+            return hit_count + overlap_scalar(query, batch, i, hits + hit_count);
+        }
+#endif
+
+#if RPG_NARROWPHASE_DISPATCH
+        __attribute__((target("avx2")))
+        std::uint32_t overlap_avx2(const OverlapQuery &query, const CandidateBatch &batch,
+                                   const std::uint32_t begin, std::uint32_t *hits) {
+            const __m256 query_min_x = _mm256_set1_ps(query.min_x);
+            const __m256 query_min_y = _mm256_set1_ps(query.min_y);
+            const __m256 query_max_x = _mm256_set1_ps(query.max_x);
+            const __m256 query_max_y = _mm256_set1_ps(query.max_y);
+            const __m256i query_layer = _mm256_set1_epi32(static_cast<int>(query.layer));
+            const __m256i query_mask = _mm256_set1_epi32(static_cast<int>(query.mask));
+            const __m256i zero = _mm256_setzero_si256();
+
+            std::uint32_t hit_count = 0;
+            std::uint32_t i = begin;
+            for (; i + 8 <= batch.size(); i += 8) {
+                const auto *layers = reinterpret_cast<const __m256i *>(batch.layers.data() + i);
+                const auto *masks = reinterpret_cast<const __m256i *>(batch.masks.data() + i);
+                const __m256i filtered = _mm256_or_si256(
+                    _mm256_cmpeq_epi32(_mm256_and_si256(query_layer, _mm256_loadu_si256(masks)), zero),
+                    _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256(layers), query_mask), zero));
+
+                const __m256 overlap = _mm256_and_ps(
+                    _mm256_and_ps(
+                        _mm256_cmp_ps(query_min_x, _mm256_loadu_ps(batch.max_x.data() + i), _CMP_LT_OQ),
+                        _mm256_cmp_ps(query_max_x, _mm256_loadu_ps(batch.min_x.data() + i), _CMP_GT_OQ)),
+                    _mm256_and_ps(
+                        _mm256_cmp_ps(query_min_y, _mm256_loadu_ps(batch.max_y.data() + i), _CMP_LT_OQ),
+                        _mm256_cmp_ps(query_max_y, _mm256_loadu_ps(batch.min_y.data() + i), _CMP_GT_OQ)));
+
+                const __m256 accepted = _mm256_andnot_ps(_mm256_castsi256_ps(filtered), overlap);
+                hit_count += append_hits(static_cast<unsigned>(_mm256_movemask_ps(accepted)), i, hits + hit_count);
+            }
+
+            return hit_count + overlap_sse(query, batch, i, hits + hit_count);
+        }
+
+        __attribute__((target("avx512f")))
+        std::uint32_t overlap_avx512(const OverlapQuery &query, const CandidateBatch &batch,
+                                     const std::uint32_t begin, std::uint32_t *hits) {
+            const __m512 query_min_x = _mm512_set1_ps(query.min_x);
+            const __m512 query_min_y = _mm512_set1_ps(query.min_y);
+            const __m512 query_max_x = _mm512_set1_ps(query.max_x);
+            const __m512 query_max_y = _mm512_set1_ps(query.max_y);
+            const __m512i query_layer = _mm512_set1_epi32(static_cast<int>(query.layer));
+            const __m512i query_mask = _mm512_set1_epi32(static_cast<int>(query.mask));
+
+            std::uint32_t hit_count = 0;
+            std::uint32_t i = begin;
+            for (; i + 16 <= batch.size(); i += 16) {
+                __mmask16 overlap = _mm512_test_epi32_mask(query_layer, _mm512_loadu_si512(batch.masks.data() + i));
+                overlap = _mm512_mask_test_epi32_mask(overlap, _mm512_loadu_si512(batch.layers.data() + i), query_mask);
+                overlap = _mm512_mask_cmp_ps_mask(overlap, query_min_x, _mm512_loadu_ps(batch.max_x.data() + i), _CMP_LT_OQ);
+                overlap = _mm512_mask_cmp_ps_mask(overlap, query_max_x, _mm512_loadu_ps(batch.min_x.data() + i), _CMP_GT_OQ);
+                overlap = _mm512_mask_cmp_ps_mask(overlap, query_min_y, _mm512_loadu_ps(batch.max_y.data() + i), _CMP_LT_OQ);
+                overlap = _mm512_mask_cmp_ps_mask(overlap, query_max_y, _mm512_loadu_ps(batch.min_y.data() + i), _CMP_GT_OQ);
+
+                hit_count += append_hits(static_cast<unsigned>(overlap), i, hits + hit_count);
+            }
+
+            return hit_count + overlap_sse(query, batch, i, hits + hit_count);
+        }
+#endif
+
+        struct KernelEntry {
+            Kernel kernel;
+            const char *name;
+        };
+
+        KernelEntry select_kernel() {
+#if RPG_NARROWPHASE_DISPATCH
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return {overlap_avx512, "avx512"};
+            if (__builtin_cpu_supports("avx2")) return {overlap_avx2, "avx2"};
+#endif
+#if RPG_NARROWPHASE_SSE
+            return {overlap_sse, "sse"};
+#else
+            return {overlap_scalar, "scalar"};
+#endif
+        }
+
+        const KernelEntry &get_kernel() {
+            static const KernelEntry entry = select_kernel();
+            return entry;
+        }
+    }
+
+    std::uint32_t overlap_batch(const OverlapQuery &query, const CandidateBatch &batch, std::uint32_t *hits) {
+        return get_kernel().kernel(query, batch, 0, hits);
+    }
+
+    std::uint32_t overlap_batch(const ColliderProxies &source, const std::uint32_t query,
+                                const CandidateBatch &batch, std::uint32_t *hits) {
+        const OverlapQuery box{
+            source.min_x[query], source.min_y[query], source.max_x[query], source.max_y[query],
+            source.layers[query], source.masks[query]
+        };
+        return overlap_batch(box, batch, hits);
+    }
+
+    const char *get_narrowphase_kernel_name() {
+        return get_kernel().name;
+    }
+
+} // namespace rpg
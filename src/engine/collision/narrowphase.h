@@ -0,0 +1,71 @@
+// narrowphase.h
+// Purpose: Batched AABB overlap tests. Candidates are gathered into contiguous
+// min/max arrays and tested against one query box 4, 8 or 16 at a time with SSE,
+// AVX2 or AVX-512 kernels; the widest kernel supported by the CPU is picked at
+// startup, with a scalar fallback on other architectures.
+
+#ifndef NARROWPHASE_H
+#define NARROWPHASE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "collider_proxies.h"
+
+namespace rpg {
+
+    // Candidate bounds and layer filters in structure-of-arrays form, plus the proxy each one came from
+    struct CandidateBatch {
+        std::vector<std::uint32_t> proxies;
+        std::vector<float> min_x;
+        std::vector<float> min_y;
+        std::vector<float> max_x;
+        std::vector<float> max_y;
+        std::vector<std::uint32_t> layers;
+        std::vector<std::uint32_t> masks;
+
+        [[nodiscard]] std::uint32_t size() const { return static_cast<std::uint32_t>(proxies.size()); }
+
+        void clear() {
+            proxies.clear();
+            min_x.clear();
+            min_y.clear();
+            max_x.clear();
+            max_y.clear();
+            layers.clear();
+            masks.clear();
+        }
+
+        void push_back(const ColliderProxies &source, const std::uint32_t proxy) {
+            proxies.push_back(proxy);
+            min_x.push_back(source.min_x[proxy]);
+            min_y.push_back(source.min_y[proxy]);
+            max_x.push_back(source.max_x[proxy]);
+            max_y.push_back(source.max_y[proxy]);
+            layers.push_back(source.layers[proxy]);
+            masks.push_back(source.masks[proxy]);
+        }
+    };
+
+    // Bounds and layer filter tested against a batch
+    struct OverlapQuery {
+        float min_x, min_y, max_x, max_y;
+        std::uint32_t layer, mask;
+    };
+
+    // Tests `query` against every candidate with the same layer filter and strict bounds test as
+    // ColliderProxies::can_collide and ColliderProxies::overlaps. Writes the batch indices of the
+    // overlapping candidates to `hits` (which must hold batch.size() entries) and returns how many
+    // were written.
+    std::uint32_t overlap_batch(const OverlapQuery &query, const CandidateBatch &batch, std::uint32_t *hits);
+
+    // Same as above, with the bounds and layer filter of proxy `query` of `source`
+    std::uint32_t overlap_batch(const ColliderProxies &source, std::uint32_t query,
+                                const CandidateBatch &batch, std::uint32_t *hits);
+
+    // Name of the kernel selected for this CPU ("avx512", "avx2", "sse" or "scalar")
+    const char *get_narrowphase_kernel_name();
+
+} // namespace rpg
+
+#endif // NARROWPHASE_H
@@ -0,0 +1,313 @@
+// spatial_grid.cpp
+// Purpose: CSR uniform grid built with a two-pass counting sort.
+// Pass one bins every point in parallel; pass two builds the cell offsets
+// with a prefix sum, leaving a few free slots per cell, and scatters the point
+// indices into a single array. Updates move single items between those slots.
+
+#include "spatial_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <limits>
+#include <numeric>
+
+namespace rpg {
+
+    namespace {
+        struct Bounds {
+            float min_x, min_y, max_x, max_y;
+        };
+
+        bool is_absent(const Vector2 &point) {
+            return std::isnan(point.x) || std::isnan(point.y);
+        }
+    }
+
+    SpatialGrid::SpatialGrid(const float cell_size)
+        : cell_size(cell_size), effective_cell_size(cell_size), inverse_cell_size(1.0f / cell_size) {
+    }
+
+    void SpatialGrid::set_cell_size(const float size) {
+        cell_size = size;
+        needs_rebuild = true;
+    }
+
+    // Computes the grid origin and dimensions for the current points, growing the
+    // effective cell size if the bounds would need more cells than the budget allows.
+    // Returns false when no point is present.
+    bool SpatialGrid::fit_bounds(const std::span<const Vector2> points) {
+        constexpr float inf = std::numeric_limits<float>::infinity();
+
+        const Bounds bounds = std::transform_reduce(
+            std::execution::par,
+            points.begin(),
+            points.end(),
+            Bounds{inf, inf, -inf, -inf},
+            [](const Bounds &a, const Bounds &b) {
+                return Bounds{
+                    std::min(a.min_x, b.min_x), std::min(a.min_y, b.min_y),
+                    std::max(a.max_x, b.max_x), std::max(a.max_y, b.max_y)
+                };
+            },
+            [](const Vector2 &point) {
+                if (is_absent(point)) return Bounds{inf, inf, -inf, -inf};
+                return Bounds{point.x, point.y, point.x, point.y};
+            }
+        );
+        if (bounds.min_x > bounds.max_x) return false;
+
+        const auto budget = static_cast<double>(std::max(MIN_CELL_BUDGET, points.size() * CELLS_PER_ITEM));
+        effective_cell_size = cell_size;
+
+        while (true) {
+            // Align the origin to the cell size so cells match world-aligned cells
+            origin = {
+                (std::floor(bounds.min_x / effective_cell_size) - BOUNDS_PADDING_CELLS) * effective_cell_size,
+                (std::floor(bounds.min_y / effective_cell_size) - BOUNDS_PADDING_CELLS) * effective_cell_size
+            };
+
+            const double width = std::floor((bounds.max_x - origin.x) / effective_cell_size) + 1.0 + BOUNDS_PADDING_CELLS;
+            const double height = std::floor((bounds.max_y - origin.y) / effective_cell_size) + 1.0 + BOUNDS_PADDING_CELLS;
+
+            if (width * height <= budget) {
+                columns = static_cast<int>(width);
+                rows = static_cast<int>(height);
+                break;
+            }
+
+            effective_cell_size *= static_cast<float>(std::sqrt(width * height / budget) * 1.05);
+        }
+
+        inverse_cell_size = 1.0f / effective_cell_size;
+        return true;
+    }
+
+    // Cell of a point against the current bounds, OUT_OF_BOUNDS outside of them
+    std::uint32_t SpatialGrid::bin_point(const Vector2 &point) const {
+        if (is_absent(point)) return NO_CELL;
+
+        const auto [column, row] = get_cell(point.x, point.y);
+        if (column < 0 || row < 0 || column >= columns || row >= rows) return OUT_OF_BOUNDS;
+        return static_cast<std::uint32_t>(row * columns + column);
+    }
+
+    void SpatialGrid::build(const std::span<const Vector2> points) {
+        needs_rebuild = false;
+        if (!fit_bounds(points)) {
+            columns = 0;
+            rows = 0;
+            item_cells.assign(points.size(), NO_CELL);
+            item_slots.assign(points.size(), NO_SLOT);
+            items.clear();
+            occupied_cells.clear();
+            cell_counts.clear();
+            cell_offsets.assign(1, 0);
+            return;
+        }
+
+        // 1. Bin every point (parallel)
+        item_cells.resize(points.size());
+        std::transform(
+            std::execution::par,
+            points.begin(),
+            points.end(),
+            item_cells.begin(),
+            [this](const Vector2 &point) {
+                if (is_absent(point)) return NO_CELL;
+
+                const int column = std::clamp(static_cast<int>((point.x - origin.x) * inverse_cell_size), 0, columns - 1);
+                const int row = std::clamp(static_cast<int>((point.y - origin.y) * inverse_cell_size), 0, rows - 1);
+                return static_cast<std::uint32_t>(row * columns + column);
+            }
+        );
+
+        sort_items();
+    }
+
+    bool SpatialGrid::update(const std::span<const Vector2> points) {
+        if (needs_rebuild || columns == 0) {
+            build(points);
+            return true;
+        }
+
+        // 1. Bin every point against the current bounds (parallel)
+        pending_cells.resize(points.size());
+        std::transform(
+            std::execution::par,
+            points.begin(),
+            points.end(),
+            pending_cells.begin(),
+            [this](const Vector2 &point) { return bin_point(point); }
+        );
+
+        if (std::find(std::execution::par, pending_cells.begin(), pending_cells.end(), OUT_OF_BOUNDS) != pending_cells.end()) {
+            build(points);
+            return true;
+        }
+
+        // 2. Items past the previous count start outside the grid, dropped ones leave it
+        const auto count = static_cast<std::uint32_t>(points.size());
+        bool changed = false;
+        for (auto item = count; item < item_cells.size(); ++item) {
+            if (item_cells[item] == NO_CELL) continue;
+            remove_item(item);
+            changed = true;
+        }
+        item_cells.resize(count, NO_CELL);
+        item_slots.resize(count, NO_SLOT);
+
+        // 3. Move only the items that changed cell. A full cell gets its slack back from a re-sort.
+        for (std::uint32_t item = 0; item < count; ++item) {
+            const std::uint32_t cell = pending_cells[item];
+            if (cell == item_cells[item]) continue;
+            changed = true;
+
+            if (item_cells[item] != NO_CELL) remove_item(item);
+            if (cell != NO_CELL && !insert_item(item, cell)) {
+                item_cells.assign(pending_cells.begin(), pending_cells.end());
+                sort_items();
+                return true;
+            }
+        }
+
+        return changed;
+    }
+
+    // Counting sort of the item indices by item_cells, leaving free slots in every cell
+    void SpatialGrid::sort_items() {
+        const auto cell_count = static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows);
+        occupied_cells.clear();
+        occupied_slots.assign(cell_count, NO_SLOT);
+
+        // 2. Count points per cell and turn the counts into start offsets
+        cell_counts.assign(cell_count, 0);
+        for (const auto cell: item_cells) {
+            if (cell != NO_CELL) ++cell_counts[cell];
+        }
+
+        cell_offsets.resize(cell_count + 1);
+        std::uint32_t running = 0;
+        for (std::size_t cell = 0; cell < cell_count; ++cell) {
+            const std::uint32_t count = cell_counts[cell];
+            if (count != 0) {
+                occupied_slots[cell] = static_cast<std::uint32_t>(occupied_cells.size());
+                occupied_cells.push_back(static_cast<std::uint32_t>(cell));
+            }
+            cell_offsets[cell] = running;
+            running += count + count / 4 + CELL_SLACK;
+            cell_counts[cell] = 0;
+        }
+        cell_offsets[cell_count] = running;
+
+        // 3. Scatter in input order, so every cell lists its items by index
+        items.resize(running);
+        item_slots.resize(item_cells.size());
+        for (std::uint32_t item = 0; item < item_cells.size(); ++item) {
+            const std::uint32_t cell = item_cells[item];
+            if (cell == NO_CELL) {
+                item_slots[item] = NO_SLOT;
+                continue;
+            }
+
+            const std::uint32_t slot = cell_offsets[cell] + cell_counts[cell]++;
+            items[slot] = item;
+            item_slots[item] = slot;
+        }
+    }
+
+    // Takes an item out of its cell by moving the last item of the cell into its slot
+    void SpatialGrid::remove_item(const std::uint32_t item) {
+        const std::uint32_t cell = item_cells[item];
+        const std::uint32_t slot = item_slots[item];
+        const std::uint32_t last = cell_offsets[cell] + --cell_counts[cell];
+
+        if (slot != last) {
+            const std::uint32_t moved = items[last];
+            items[slot] = moved;
+            item_slots[moved] = slot;
+        }
+
+        if (cell_counts[cell] == 0) {
+            const std::uint32_t position = occupied_slots[cell];
+            const std::uint32_t back = occupied_cells.back();
+            occupied_cells[position] = back;
+            occupied_slots[back] = position;
+            occupied_cells.pop_back();
+            occupied_slots[cell] = NO_SLOT;
+        }
+
+        item_cells[item] = NO_CELL;
+        item_slots[item] = NO_SLOT;
+    }
+
+    // Appends an item to a cell; returns false when the cell has no free slot left
+    bool SpatialGrid::insert_item(const std::uint32_t item, const std::uint32_t cell) {
+        const std::uint32_t slot = cell_offsets[cell] + cell_counts[cell];
+        if (slot == cell_offsets[cell + 1]) return false;
+
+        if (cell_counts[cell]++ == 0) {
+            occupied_slots[cell] = static_cast<std::uint32_t>(occupied_cells.size());
+            occupied_cells.push_back(cell);
+        }
+
+        items[slot] = item;
+        item_cells[item] = cell;
+        item_slots[item] = slot;
+        return true;
+    }
+
+    std::pair<int, int> SpatialGrid::get_cell(const float x, const float y) const {
+        return {
+            static_cast<int>(std::floor((x - origin.x) * inverse_cell_size)),
+            static_cast<int>(std::floor((y - origin.y) * inverse_cell_size))
+        };
+    }
+
+    std::span<const std::uint32_t> SpatialGrid::get_cell_items(const int column, const int row) const {
+        if (column < 0 || row < 0 || column >= columns || row >= rows) return {};
+        return get_cell_items(static_cast<std::uint32_t>(row * columns + column));
+    }
+
+    std::span<const std::uint32_t> SpatialGrid::get_cell_items(const std::uint32_t cell_index) const {
+        return {items.data() + cell_offsets[cell_index], cell_counts[cell_index]};
+    }
+
+    Rectangle SpatialGrid::get_cell_rect(const std::uint32_t cell_index) const {
+        const auto column = static_cast<float>(cell_index % static_cast<std::uint32_t>(columns));
+        const auto row = static_cast<float>(cell_index / static_cast<std::uint32_t>(columns));
+        return {
+            origin.x + column * effective_cell_size,
+            origin.y + row * effective_cell_size,
+            effective_cell_size,
+            effective_cell_size
+        };
+    }
+
+    Rectangle SpatialGrid::get_bounds() const {
+        return {
+            origin.x,
+            origin.y,
+            static_cast<float>(columns) * effective_cell_size,
+            static_cast<float>(rows) * effective_cell_size
+        };
+    }
+
+    // Clamping happens in floating point, so areas far outside the grid cannot overflow the cell coordinates
+    SpatialGrid::CellRange SpatialGrid::get_cell_range(const Rectangle &area, const int margin) const {
+        constexpr float lowest = -std::numeric_limits<float>::infinity();
+
+        const auto to_cell = [this](const float position, const float start, const int offset, const int count) {
+            const float cell = std::floor((position - start) * inverse_cell_size) + static_cast<float>(offset);
+            return static_cast<int>(std::clamp(cell, -1.0f, static_cast<float>(count)));
+        };
+
+        return {
+            std::max(to_cell(area.x, origin.x, -margin, columns), 0),
+            std::max(to_cell(area.y, origin.y, -margin, rows), 0),
+            std::min(to_cell(std::nextafter(area.x + area.width, lowest), origin.x, margin, columns), columns - 1),
+            std::min(to_cell(std::nextafter(area.y + area.height, lowest), origin.y, margin, rows), rows - 1)
+        };
+    }
+
+} // namespace rpg
@@ -0,0 +1,136 @@
+// spatial_grid.h
+// Purpose: Dense uniform grid used as a broadphase acceleration structure.
+// Cells are stored in CSR layout with some slack: the points of cell `c` are
+// items[cell_offsets[c] .. cell_offsets[c] + cell_counts[c]), where each item is an
+// index into the array passed to build(), and the slots up to cell_offsets[c + 1]
+// are free. update() moves the points that changed cell between those free slots
+// instead of sorting everything again.
+
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include <raylib.h>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace rpg {
+
+    class SpatialGrid {
+    public:
+        // Inclusive range of cells, clamped to the grid; empty when a minimum exceeds its maximum
+        struct CellRange {
+            int min_column;
+            int min_row;
+            int max_column;
+            int max_row;
+        };
+
+        explicit SpatialGrid(float cell_size);
+
+        // Rebuilds the grid from scratch with a two-pass counting sort. Points with a NaN
+        // coordinate are left out. Buffers keep their capacity, so once they reach the working
+        // size a rebuild does not allocate.
+        void build(std::span<const Vector2> points);
+
+        // Re-bins the points against the current bounds and moves only the items that changed
+        // cell, keeping the cell of every item between calls. Items keep their index: points past
+        // the previous count are added, the ones a shorter span drops are removed, and a NaN point
+        // takes its item out of the grid. Falls back to build() when a point left the padded
+        // bounds or a cell ran out of free slots. Returns true if the grid contents changed.
+        bool update(std::span<const Vector2> points);
+
+        // Grid coordinates (column, row) of a world position. May be out of range.
+        [[nodiscard]] std::pair<int, int> get_cell(float x, float y) const;
+
+        // Indices of the points stored in a cell; empty when the cell is out of range.
+        [[nodiscard]] std::span<const std::uint32_t> get_cell_items(int column, int row) const;
+
+        [[nodiscard]] std::span<const std::uint32_t> get_cell_items(std::uint32_t cell_index) const;
+
+        // World-space rectangle covered by a cell
+        [[nodiscard]] Rectangle get_cell_rect(std::uint32_t cell_index) const;
+
+        // World-space rectangle covered by the whole grid
+        [[nodiscard]] Rectangle get_bounds() const;
+
+        // Cells overlapping `area`, grown by `margin` cells on every side
+        [[nodiscard]] CellRange get_cell_range(const Rectangle &area, int margin) const;
+
+        // Calls visit(item) for every item binned in the cells overlapping `area`, grown by `margin` cells
+        template<typename Visit>
+        void for_each_item(const Rectangle &area, const int margin, Visit &&visit) const {
+            const CellRange range = get_cell_range(area, margin);
+            for (int row = range.min_row; row <= range.max_row; row++) {
+                for (int column = range.min_column; column <= range.max_column; column++) {
+                    for (const auto item: get_cell_items(static_cast<std::uint32_t>(row * columns + column))) {
+                        visit(item);
+                    }
+                }
+            }
+        }
+
+        // Linear indices of the cells that hold at least one point.
+        [[nodiscard]] std::span<const std::uint32_t> get_occupied_cells() const { return occupied_cells; }
+
+        [[nodiscard]] int get_columns() const { return columns; }
+        [[nodiscard]] int get_rows() const { return rows; }
+
+        // Requested cell size and the size actually used by the last build, which is
+        // only larger when the point bounds would exceed the cell budget.
+        [[nodiscard]] float get_cell_size() const { return cell_size; }
+        [[nodiscard]] float get_effective_cell_size() const { return effective_cell_size; }
+
+        void set_cell_size(float size);
+
+    private:
+        float cell_size;
+        float effective_cell_size;
+        float inverse_cell_size;
+        Vector2 origin{0.0f, 0.0f};
+        int columns = 0;
+        int rows = 0;
+        bool needs_rebuild = true;
+
+        std::vector<std::uint32_t> cell_offsets;
+        std::vector<std::uint32_t> cell_counts;
+        // Cell of each item (NO_CELL when it is not in the grid) and its slot in `items`
+        std::vector<std::uint32_t> item_cells;
+        std::vector<std::uint32_t> item_slots;
+        std::vector<std::uint32_t> items;
+        // Non-empty cells in no particular order, and the position of each cell in that list
+        std::vector<std::uint32_t> occupied_cells;
+        std::vector<std::uint32_t> occupied_slots;
+        std::vector<std::uint32_t> pending_cells;
+
+        bool fit_bounds(std::span<const Vector2> points);
+
+        [[nodiscard]] std::uint32_t bin_point(const Vector2 &point) const;
+
+        void sort_items();
+
+        void remove_item(std::uint32_t item);
+
+        bool insert_item(std::uint32_t item, std::uint32_t cell);
+
+        // Upper bound on the number of cells, as a multiple of the point count,
+        // so sparse outliers cannot blow up the offset array (default: 4).
+        static constexpr std::size_t CELLS_PER_ITEM = 4;
+        // Cell budget for small point sets (default: 1024).
+        static constexpr std::size_t MIN_CELL_BUDGET = 1024;
+        // Empty cells kept around the point bounds so small moves do not force a rebuild (default: 2).
+        static constexpr int BOUNDS_PADDING_CELLS = 2;
+        // Free slots given to every cell on top of a quarter of its items, so points can move in
+        // without a rebuild (default: 2).
+        static constexpr std::uint32_t CELL_SLACK = 2;
+        // Marks a point that falls outside the grid during update().
+        static constexpr std::uint32_t OUT_OF_BOUNDS = 0xFFFFFFFFu;
+        // Marks an item that is not in any cell, and a cell that is not in occupied_cells.
+        static constexpr std::uint32_t NO_CELL = 0xFFFFFFFEu;
+        static constexpr std::uint32_t NO_SLOT = 0xFFFFFFFFu;
+    };
+
+} // namespace rpg
+
+#endif // SPATIAL_GRID_H
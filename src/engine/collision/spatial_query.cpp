@@ -0,0 +1,258 @@
+// spatial_query.cpp
+// Purpose: Region, radius, raycast and nearest queries on top of the broadphase interface.
+
+#include "spatial_query.h"
+
+#include <algorithm>
+#include <cmath>
+#include <execution>
+#include <numeric>
+#include <utility>
+
+namespace rpg {
+
+    void SpatialQuery::attach(const Broadphase *broadphase, const ColliderProxies *proxies) {
+        this->broadphase = broadphase;
+        this->proxies = proxies;
+
+        if (proxies->size() == 0) {
+            world_bounds = {0.0f, 0.0f, 0.0f, 0.0f};
+            return;
+        }
+
+        float min_x = proxies->min_x[0], min_y = proxies->min_y[0];
+        float max_x = proxies->max_x[0], max_y = proxies->max_y[0];
+        for (std::uint32_t proxy = 1; proxy < proxies->size(); ++proxy) {
+            min_x = std::min(min_x, proxies->min_x[proxy]);
+            min_y = std::min(min_y, proxies->min_y[proxy]);
+            max_x = std::max(max_x, proxies->max_x[proxy]);
+            max_y = std::max(max_y, proxies->max_y[proxy]);
+        }
+        world_bounds = {min_x, min_y, max_x - min_x, max_y - min_y};
+    }
+
+    void SpatialQuery::detach() {
+        broadphase = nullptr;
+        proxies = nullptr;
+    }
+
+    // Squared distance from a point to the bounds of a proxy; zero inside them
+    float SpatialQuery::distance_squared(const std::uint32_t proxy, const Vector2 &point) const {
+        const float dx = std::max({proxies->min_x[proxy] - point.x, 0.0f, point.x - proxies->max_x[proxy]});
+        const float dy = std::max({proxies->min_y[proxy] - point.y, 0.0f, point.y - proxies->max_y[proxy]});
+        return dx * dx + dy * dy;
+    }
+
+    void SpatialQuery::query_region(
+        const Rectangle &area,
+        std::vector<entt::entity> &results,
+        const std::uint32_t layer_mask
+    ) const {
+        thread_local std::vector<std::uint32_t> candidates;
+
+        results.clear();
+        if (!broadphase) return;
+
+        candidates.clear();
+        broadphase->query_region(*proxies, area, layer_mask, candidates);
+        for (const auto proxy: candidates) {
+            results.push_back(proxies->entities[proxy]);
+        }
+    }
+
+    // Appends the colliders within the radius to `results`
+    void SpatialQuery::collect_radius(const RadiusQuery &query, std::vector<entt::entity> &results) const {
+        thread_local std::vector<std::uint32_t> candidates;
+
+        if (!broadphase) return;
+
+        const Rectangle area{
+            query.center.x - query.radius, query.center.y - query.radius,
+            query.radius * 2.0f, query.radius * 2.0f
+        };
+
+        candidates.clear();
+        broadphase->query_region(*proxies, area, query.layer_mask, candidates);
+
+        const float radius_squared = query.radius * query.radius;
+        for (const auto proxy: candidates) {
+            if (distance_squared(proxy, query.center) < radius_squared) {
+                results.push_back(proxies->entities[proxy]);
+            }
+        }
+    }
+
+    void SpatialQuery::query_radius(const RadiusQuery &query, std::vector<entt::entity> &results) const {
+        results.clear();
+        collect_radius(query, results);
+    }
+
+    // Searches squares of doubling size around the point. Every collider closer than the half
+    // size overlaps the square, so once that circle holds `count` colliders they are the nearest.
+    void SpatialQuery::collect_nearest(const NearestQuery &query, std::vector<entt::entity> &results) const {
+        thread_local std::vector<std::uint32_t> candidates;
+        thread_local std::vector<std::pair<float, entt::entity> > ranked;
+
+        if (!broadphase || proxies->size() == 0 || query.count == 0) return;
+
+        // Distance to the farthest corner of the world: past it every collider has been seen
+        const float far_x = std::max(std::abs(query.point.x - world_bounds.x),
+                                     std::abs(query.point.x - (world_bounds.x + world_bounds.width)));
+        const float far_y = std::max(std::abs(query.point.y - world_bounds.y),
+                                     std::abs(query.point.y - (world_bounds.y + world_bounds.height)));
+        const float reach = std::sqrt(far_x * far_x + far_y * far_y);
+
+        float radius = std::min(INITIAL_NEAREST_RADIUS, query.max_distance);
+        while (true) {
+            const Rectangle area{query.point.x - radius, query.point.y - radius, radius * 2.0f, radius * 2.0f};
+
+            candidates.clear();
+            broadphase->query_region(*proxies, area, query.layer_mask, candidates);
+
+            ranked.clear();
+            const float radius_squared = radius * radius;
+            for (const auto proxy: candidates) {
+                const float distance = distance_squared(proxy, query.point);
+                if (distance < radius_squared) {
+                    ranked.emplace_back(distance, proxies->entities[proxy]);
+                }
+            }
+
+            if (ranked.size() >= query.count || radius > reach || radius >= query.max_distance) break;
+            radius = std::min(radius * 2.0f, query.max_distance);
+        }
+
+        const auto count = std::min<std::size_t>(query.count, ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + static_cast<std::ptrdiff_t>(count), ranked.end());
+        for (std::size_t i = 0; i < count; ++i) {
+            results.push_back(ranked[i].second);
+        }
+    }
+
+    void SpatialQuery::query_nearest(const NearestQuery &query, std::vector<entt::entity> &results) const {
+        results.clear();
+        collect_nearest(query, results);
+    }
+
+    namespace {
+        // Ray of `max_distance` along the normalized direction, so a fraction maps to a distance
+        RaySegment make_segment(const RayQuery &query) {
+            const float length = std::sqrt(query.direction.x * query.direction.x + query.direction.y * query.direction.y);
+            const float scale = length > 0.0f ? query.max_distance / length : 0.0f;
+            return {query.origin, {query.direction.x * scale, query.direction.y * scale}};
+        }
+
+        RaycastHit make_hit(const RayQuery &query, const RaySegment &segment, const entt::entity entity, const float fraction) {
+            return {
+                entity,
+                {segment.origin.x + segment.translation.x * fraction, segment.origin.y + segment.translation.y * fraction},
+                fraction * query.max_distance
+            };
+        }
+    }
+
+    bool SpatialQuery::raycast(const RayQuery &query, RaycastHit &hit) const {
+        hit = {};
+        if (!broadphase) return false;
+
+        const RaySegment segment = make_segment(query);
+        float best_fraction = 1.0f;
+        std::uint32_t best_proxy = 0;
+        bool found = false;
+
+        broadphase->raycast(*proxies, segment, query.layer_mask, [&](const std::uint32_t proxy, const float fraction) {
+            // Equal fractions are broken by entity, so every backend reports the same hit
+            if (!found || fraction < best_fraction ||
+                (fraction == best_fraction && proxies->entities[proxy] < proxies->entities[best_proxy])) {
+                best_fraction = fraction;
+                best_proxy = proxy;
+                found = true;
+            }
+            return best_fraction;
+        });
+
+        if (found) {
+            hit = make_hit(query, segment, proxies->entities[best_proxy], best_fraction);
+        }
+        return found;
+    }
+
+    void SpatialQuery::raycast_all(const RayQuery &query, std::vector<RaycastHit> &hits) const {
+        hits.clear();
+        if (!broadphase) return;
+
+        const RaySegment segment = make_segment(query);
+        broadphase->raycast(*proxies, segment, query.layer_mask, [&](const std::uint32_t proxy, const float fraction) {
+            hits.push_back(make_hit(query, segment, proxies->entities[proxy], fraction));
+            return 1.0f;
+        });
+
+        std::sort(hits.begin(), hits.end(), [](const RaycastHit &a, const RaycastHit &b) {
+            return a.distance != b.distance ? a.distance < b.distance : a.entity < b.entity;
+        });
+    }
+
+    // Runs chunks of queries in parallel, each chunk appending to its own buffer, then
+    // concatenates the buffers in query order.
+    template<typename Query, typename Collect>
+    void SpatialQuery::run_batch(const std::span<const Query> queries, BatchResults &results, Collect &&collect) const {
+        const std::size_t chunk_count = (queries.size() + BATCH_CHUNK_SIZE - 1) / BATCH_CHUNK_SIZE;
+        if (results.chunks.size() < chunk_count) {
+            results.chunks.resize(chunk_count);
+        }
+        const std::span chunk_results(results.chunks.data(), chunk_count);
+        results.offsets.assign(queries.size() + 1, 0);
+
+        std::for_each(
+            std::execution::par,
+            chunk_results.begin(),
+            chunk_results.end(),
+            [&](std::vector<entt::entity> &chunk_entities) {
+                const auto chunk = static_cast<std::size_t>(&chunk_entities - chunk_results.data());
+                chunk_entities.clear();
+                const std::size_t end = std::min(queries.size(), (chunk + 1) * BATCH_CHUNK_SIZE);
+
+                for (std::size_t i = chunk * BATCH_CHUNK_SIZE; i < end; ++i) {
+                    const std::size_t before = chunk_entities.size();
+                    collect(queries[i], chunk_entities);
+                    results.offsets[i + 1] = static_cast<std::uint32_t>(chunk_entities.size() - before);
+                }
+            }
+        );
+
+        std::inclusive_scan(results.offsets.begin(), results.offsets.end(), results.offsets.begin());
+
+        results.entities.clear();
+        results.entities.reserve(results.offsets.back());
+        for (const auto &chunk_entities: chunk_results) {
+            results.entities.insert(results.entities.end(), chunk_entities.begin(), chunk_entities.end());
+        }
+    }
+
+    void SpatialQuery::query_radius_batch(const std::span<const RadiusQuery> queries, BatchResults &results) const {
+        run_batch(queries, results, [this](const RadiusQuery &query, std::vector<entt::entity> &entities) {
+            collect_radius(query, entities);
+        });
+    }
+
+    void SpatialQuery::query_nearest_batch(const std::span<const NearestQuery> queries, BatchResults &results) const {
+        run_batch(queries, results, [this](const NearestQuery &query, std::vector<entt::entity> &entities) {
+            collect_nearest(query, entities);
+        });
+    }
+
+    void SpatialQuery::raycast_batch(const std::span<const RayQuery> queries, std::vector<RaycastHit> &hits) const {
+        hits.resize(queries.size());
+
+        std::for_each(
+            std::execution::par,
+            queries.begin(),
+            queries.end(),
+            [&](const RayQuery &query) {
+                const auto index = static_cast<std::size_t>(&query - queries.data());
+                raycast(query, hits[index]);
+            }
+        );
+    }
+
+} // namespace rpg
@@ -0,0 +1,117 @@
+// spatial_query.h
+// Purpose: Read-only access to the broadphase built by CollisionDetectionSystem, stored
+// in the registry context. Answers region, radius, raycast and k-nearest queries against
+// the collider bounds of the last collision detection run, singly or in parallel batches.
+
+#ifndef SPATIAL_QUERY_H
+#define SPATIAL_QUERY_H
+
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "entt/entt.hpp"
+#include "broadphase.h"
+#include "collider_proxies.h"
+
+namespace rpg {
+
+    struct RadiusQuery {
+        Vector2 center;
+        float radius;
+        // Only colliders whose layer is in the mask are returned
+        std::uint32_t layer_mask = BoxCollider2D::ALL_LAYERS;
+    };
+
+    struct NearestQuery {
+        Vector2 point;
+        std::uint32_t count;
+        std::uint32_t layer_mask = BoxCollider2D::ALL_LAYERS;
+        float max_distance = std::numeric_limits<float>::infinity();
+    };
+
+    struct RayQuery {
+        Vector2 origin;
+        Vector2 direction;
+        float max_distance;
+        std::uint32_t layer_mask = BoxCollider2D::ALL_LAYERS;
+    };
+
+    struct RaycastHit {
+        entt::entity entity = entt::null;
+        Vector2 point{0.0f, 0.0f};
+        float distance = 0.0f;
+    };
+
+    // Results of a batched query in CSR form: the results of query `i` are
+    // entities[offsets[i] .. offsets[i + 1]).
+    struct BatchResults {
+        std::vector<entt::entity> entities;
+        std::vector<std::uint32_t> offsets;
+        // Results of each parallel chunk of the batch; reusing the same BatchResults across
+        // batches keeps them from allocating once warmed up.
+        std::vector<std::vector<entt::entity> > chunks;
+
+        [[nodiscard]] std::span<const entt::entity> get(const std::size_t query) const {
+            return {entities.data() + offsets[query], offsets[query + 1] - offsets[query]};
+        }
+    };
+
+    class SpatialQuery {
+        const Broadphase *broadphase = nullptr;
+        const ColliderProxies *proxies = nullptr;
+
+        // Bounds of every proxy, to know when a nearest query has seen everything
+        Rectangle world_bounds{0.0f, 0.0f, 0.0f, 0.0f};
+
+        void collect_radius(const RadiusQuery &query, std::vector<entt::entity> &results) const;
+
+        void collect_nearest(const NearestQuery &query, std::vector<entt::entity> &results) const;
+
+        template<typename Query, typename Collect>
+        void run_batch(std::span<const Query> queries, BatchResults &results, Collect &&collect) const;
+
+        [[nodiscard]] float distance_squared(std::uint32_t proxy, const Vector2 &point) const;
+
+    public:
+        // Called by CollisionDetectionSystem once the broadphase is up to date with `proxies`
+        void attach(const Broadphase *broadphase, const ColliderProxies *proxies);
+
+        void detach();
+
+        // Colliders whose bounds overlap `area`
+        void query_region(const Rectangle &area, std::vector<entt::entity> &results,
+                          std::uint32_t layer_mask = BoxCollider2D::ALL_LAYERS) const;
+
+        // Colliders whose bounds are closer than `radius` to the center
+        void query_radius(const RadiusQuery &query, std::vector<entt::entity> &results) const;
+
+        // Up to `count` colliders sorted by the distance from the point to their bounds
+        void query_nearest(const NearestQuery &query, std::vector<entt::entity> &results) const;
+
+        // Closest collider hit by the ray; returns false if nothing was hit
+        bool raycast(const RayQuery &query, RaycastHit &hit) const;
+
+        // Every collider hit by the ray, sorted by distance
+        void raycast_all(const RayQuery &query, std::vector<RaycastHit> &hits) const;
+
+        // Batched versions, running the queries in parallel. Raycasts write one hit per query,
+        // with a null entity when the ray hit nothing.
+        void query_radius_batch(std::span<const RadiusQuery> queries, BatchResults &results) const;
+
+        void query_nearest_batch(std::span<const NearestQuery> queries, BatchResults &results) const;
+
+        void raycast_batch(std::span<const RayQuery> queries, std::vector<RaycastHit> &hits) const;
+
+    private:
+        // Half size of the first square searched by a nearest query; it doubles until enough
+        // colliders are found (default: 128.0f).
+        static constexpr float INITIAL_NEAREST_RADIUS = 128.0f;
+        // Queries per parallel chunk of a batch (default: 64).
+        static constexpr std::size_t BATCH_CHUNK_SIZE = 64;
+    };
+
+} // namespace rpg
+
+#endif // SPATIAL_QUERY_H
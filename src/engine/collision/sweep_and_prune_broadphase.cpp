@@ -0,0 +1,136 @@
+// sweep_and_prune_broadphase.cpp
+// Purpose: Insertion-sorted endpoint list and a parallel sweep over it.
+
+#include "sweep_and_prune_broadphase.h"
+
+#include <algorithm>
+
+namespace rpg {
+
+    // Passive proxies are part of the same endpoint list, so the flags do not matter here: every
+    // endpoint is matched with the proxy of its entity instead
+    void SweepAndPruneBroadphase::update(const ColliderProxies &proxies, bool, bool) {
+        const auto by_min_x = [](const Endpoint &a, const Endpoint &b) { return a.min_x < b.min_x; };
+
+        for (std::uint32_t proxy = 0; proxy < proxies.size(); ++proxy) {
+            const auto slot = static_cast<std::size_t>(entt::to_entity(proxies.entities[proxy]));
+            if (slot >= entity_proxies.size()) {
+                entity_proxies.resize(slot + 1, NO_PROXY);
+            }
+            entity_proxies[slot] = proxy;
+        }
+
+        // Refresh the proxy and key of every endpoint, dropping the ones whose collider is gone
+        has_endpoint.assign(proxies.size(), false);
+        std::erase_if(endpoints, [&](Endpoint &endpoint) {
+            const std::uint32_t proxy = entity_proxies[static_cast<std::size_t>(entt::to_entity(endpoint.entity))];
+            if (proxy >= proxies.size() || proxies.entities[proxy] != endpoint.entity || has_endpoint[proxy]) return true;
+
+            endpoint.proxy = proxy;
+            endpoint.min_x = proxies.min_x[proxy];
+            has_endpoint[proxy] = true;
+            return false;
+        });
+
+        // Repair the order with an insertion sort (temporal coherence)
+        for (std::size_t i = 1; i < endpoints.size(); ++i) {
+            const Endpoint endpoint = endpoints[i];
+            std::size_t j = i;
+            while (j > 0 && endpoints[j - 1].min_x > endpoint.min_x) {
+                endpoints[j] = endpoints[j - 1];
+                --j;
+            }
+            endpoints[j] = endpoint;
+        }
+
+        // New colliders are sorted on their own and merged in
+        const auto kept = static_cast<std::ptrdiff_t>(endpoints.size());
+        for (std::uint32_t proxy = 0; proxy < proxies.size(); ++proxy) {
+            if (!has_endpoint[proxy]) {
+                endpoints.push_back({proxies.min_x[proxy], proxy, proxies.entities[proxy]});
+            }
+        }
+        if (endpoints.size() > static_cast<std::size_t>(kept)) {
+            std::sort(endpoints.begin() + kept, endpoints.end(), by_min_x);
+            std::inplace_merge(endpoints.begin(), endpoints.begin() + kept, endpoints.end(), by_min_x);
+        }
+    }
+
+    // Sweeps every endpoint forward until the next min_x passes its max_x. The sweep of each
+    // endpoint is independent, so chunks of the sorted list run in parallel.
+    void SweepAndPruneBroadphase::find_pairs(const ColliderProxies &proxies, std::vector<ProxyPair> &pairs) {
+        candidates_tested = 0;
+
+        pair_buffers.run(endpoints.size(), pairs, [&](const std::size_t begin, const std::size_t end, auto &buffer) {
+            std::uint64_t tested = 0;
+            for (std::size_t i = begin; i < end; ++i) {
+                const std::uint32_t proxy_a = endpoints[i].proxy;
+                const float max_x_a = proxies.max_x[proxy_a];
+                const bool passive_a = proxies.is_passive(proxy_a);
+
+                for (std::size_t j = i + 1; j < endpoints.size() && endpoints[j].min_x < max_x_a; ++j) {
+                    const std::uint32_t proxy_b = endpoints[j].proxy;
+                    if (passive_a && proxies.is_passive(proxy_b)) continue;
+
+                    ++tested;
+                    if (proxies.can_collide(proxy_a, proxy_b) && proxies.overlaps(proxy_a, proxy_b)) {
+                        buffer.push_back(std::minmax(proxy_a, proxy_b));
+                    }
+                }
+            }
+            candidates_tested.fetch_add(tested, std::memory_order_relaxed);
+        });
+    }
+
+    void SweepAndPruneBroadphase::collect_stats(BroadphaseStats &stats) const {
+        stats.candidates_tested = candidates_tested.load(std::memory_order_relaxed);
+    }
+
+    void SweepAndPruneBroadphase::query_region(
+        const ColliderProxies &proxies,
+        const Rectangle &area,
+        const std::uint32_t layer_mask,
+        std::vector<std::uint32_t> &results
+    ) const {
+        const float max_x = area.x + area.width;
+        const float max_y = area.y + area.height;
+
+        for (const auto &endpoint: endpoints) {
+            if (endpoint.min_x >= max_x) break;
+
+            const std::uint32_t proxy = endpoint.proxy;
+            if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+            if (proxies.max_x[proxy] > area.x && proxies.min_y[proxy] < max_y && proxies.max_y[proxy] > area.y) {
+                results.push_back(proxy);
+            }
+        }
+    }
+
+    void SweepAndPruneBroadphase::raycast(
+        const ColliderProxies &proxies,
+        const RaySegment &ray,
+        const std::uint32_t layer_mask,
+        const RaycastCallback &callback
+    ) const {
+        const float max_x = std::max(ray.origin.x, ray.origin.x + ray.translation.x);
+        float max_fraction = 1.0f;
+
+        for (const auto &endpoint: endpoints) {
+            if (endpoint.min_x > max_x) break;
+
+            const std::uint32_t proxy = endpoint.proxy;
+            if ((proxies.layers[proxy] & layer_mask) == 0) continue;
+
+            const float fraction = intersect_ray(
+                ray, proxies.min_x[proxy], proxies.min_y[proxy], proxies.max_x[proxy], proxies.max_y[proxy], max_fraction
+            );
+            if (fraction < 0.0f) continue;
+
+            const float clipped = callback(proxy, fraction);
+            if (clipped < 0.0f) return;
+            max_fraction = std::min(max_fraction, clipped);
+        }
+    }
+
+} // namespace rpg
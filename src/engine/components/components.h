@@ -5,9 +5,7 @@
 #define COMPONENTS_H
 
 #include <raylib.h>
-#include <string>
-#include <unordered_set>
-#include <utility>
+#include <cstdint>
 
 #include "entt/entt.hpp"
 
@@ -31,14 +29,21 @@ namespace rpg {
             : move_direction(move_direction) {}
     };
 
+    // Index of a region in the SpriteAtlas of the registry context, see get_sprite_handle
+    using SpriteHandle = std::uint32_t;
+    // Handle of the empty region, drawn as nothing
+    constexpr SpriteHandle EMPTY_SPRITE = 0;
+
     struct Sprite {
-        std::string name;
+        SpriteHandle handle = EMPTY_SPRITE;
         mutable Vector2 size{};
         Color color{};
+        // raylib BlendMode the sprite is drawn with
+        int blend_mode = BLEND_ALPHA;
         Sprite() = default;
 
-        explicit Sprite(std::string name, const Vector2 size, const Color color)
-            : name(std::move(name)), size(size), color(color) {}
+        explicit Sprite(const SpriteHandle handle, const Vector2 size, const Color color)
+            : handle(handle), size(size), color(color) {}
     };
 
     struct Transform {
@@ -58,12 +63,33 @@ namespace rpg {
         bool is_trigger = false;
         bool is_static = false;
         bool sync_size_with_sprite = true;
-        std::unordered_set<entt::entity> colliding_entities;
+        // Two colliders are only tested against each other when each one's layer is in the other's mask
+        std::uint32_t layer = 1;
+        std::uint32_t mask = ALL_LAYERS;
+        // Layers this collider is pushed out of by OverlapCorrectionSystem; the same rule applies both ways
+        std::uint32_t solid_mask = ALL_LAYERS;
 
         BoxCollider2D() = default;
-        BoxCollider2D(float width, float height, bool is_colliding, bool is_trigger, bool is_static, bool sync_size_with_sprite)
+        BoxCollider2D(float width, float height, bool is_colliding, bool is_trigger, bool is_static, bool sync_size_with_sprite,
+                      std::uint32_t layer = 1, std::uint32_t mask = ALL_LAYERS, std::uint32_t solid_mask = ALL_LAYERS)
             : width(width), height(height), is_colliding(is_colliding),
-              is_trigger(is_trigger), is_static(is_static), sync_size_with_sprite(sync_size_with_sprite) {}
+              is_trigger(is_trigger), is_static(is_static), sync_size_with_sprite(sync_size_with_sprite),
+              layer(layer), mask(mask), solid_mask(solid_mask) {}
+
+        [[nodiscard]] bool can_collide_with(const BoxCollider2D &other) const {
+            return (layer & other.mask) != 0 && (other.layer & mask) != 0;
+        }
+
+        [[nodiscard]] bool is_solid_with(const BoxCollider2D &other) const {
+            return (layer & other.solid_mask) != 0 && (other.layer & solid_mask) != 0;
+        }
+
+        static constexpr std::uint32_t ALL_LAYERS = 0xFFFFFFFF;
+    };
+
+    // Opt-in continuous collision for fast movers: the motion from MovementData::previous_position
+    // to the current position is swept against the other colliders and clamped at the first impact.
+    struct ContinuousCollision {
     };
 
     struct MovementData {
@@ -76,6 +102,29 @@ namespace rpg {
             : velocity(velocity), speed(speed), previous_position(previous_position) {}
     };
 
+    // Tag of a resting body, added and removed by SleepSystem. Sleeping bodies are skipped by the
+    // move and overlap systems and stay in the broadphase as passive colliders, in a set of their
+    // own so falling asleep or waking up never rebuilds the static colliders.
+    struct Sleeping {
+    };
+
+    // How long a body has been resting, kept by SleepSystem
+    struct SleepState {
+        // Where the body was when it came to rest; drifting away from it restarts the count
+        Vector2 rest_position{0.0f, 0.0f};
+        std::uint32_t still_frames = 0;
+    };
+
+    // Tag of a body steered toward the player by FlowFieldSystem, which sets its velocity every step
+    struct FlowFieldAgent {
+    };
+
+    // Playable area, stored in the registry context by the scene. Systems that keep a grid over the
+    // world, like FlowFieldSystem, cover this rectangle.
+    struct WorldBounds {
+        Rectangle area;
+    };
+
 } // namespace rpg
 
 #endif // COMPONENTS_H
@@ -0,0 +1,48 @@
+// fixed_timestep.h
+// Purpose: Fixed simulation rate used by APP::run, stored in the registry context. Simulation
+// systems are stepped at `step` seconds; render systems run once per frame and draw bodies
+// interpolated between the last two simulation states.
+
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <cmath>
+#include <cstdint>
+
+#include "raylib.h"
+#include "entt/entt.hpp"
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    struct FixedTimestep {
+        // Seconds simulated per step (default: 1/60).
+        float step = 1.0f / 60.0f;
+        // Steps run at most per rendered frame; time left over beyond them is dropped so a slow
+        // frame cannot make the next one slower (default: 5).
+        int max_steps_per_frame = 5;
+
+        // Set by APP::run every frame: how far the frame is between the last two simulation
+        // states, in [0, 1), and the steps run for it
+        float alpha = 0.0f;
+        int steps_this_frame = 0;
+        std::uint64_t total_steps = 0;
+    };
+
+    // Where to draw an entity: bodies with MovementData are interpolated from the position they had
+    // before the last step, anything else is drawn where it is
+    inline Vector2 get_render_position(const entt::registry &registry, const entt::entity entity,
+                                       const Transform &transform) {
+        const auto *movement_data = registry.try_get<MovementData>(entity);
+        const auto *fixed_timestep = registry.ctx().find<FixedTimestep>();
+        if (!movement_data || !fixed_timestep) return transform.position;
+
+        return {
+            std::lerp(movement_data->previous_position.x, transform.position.x, fixed_timestep->alpha),
+            std::lerp(movement_data->previous_position.y, transform.position.y, fixed_timestep->alpha)
+        };
+    }
+
+} // namespace rpg
+
+#endif // FIXED_TIMESTEP_H
@@ -0,0 +1,114 @@
+// null_render_backend.cpp
+// Purpose: Recording of the draw calls the render systems would make, without drawing anything.
+
+#include "null_render_backend.h"
+
+namespace rpg {
+
+    NullRenderBackend::NullRenderBackend(const std::uint64_t frame_limit, const Vector2 screen_size,
+                                         const float frame_time)
+        : screen_size(screen_size), frame_time(frame_time), frame_limit(frame_limit) {
+    }
+
+    void NullRenderBackend::flush() {
+        if (batch_vertices == 0) return;
+        batch_vertices = 0;
+        ++stats.batch_flushes;
+    }
+
+    void NullRenderBackend::flush_quads() {
+        if (pending_quad_vertices == 0) return;
+        pending_quad_vertices = 0;
+        ++stats.batch_flushes;
+    }
+
+    void NullRenderBackend::add_vertices(const std::uint32_t vertex_count) {
+        stats.vertices += vertex_count;
+        stats.quads += vertex_count / 4;
+    }
+
+    bool NullRenderBackend::should_close() const {
+        return stats.frames >= frame_limit;
+    }
+
+    float NullRenderBackend::get_frame_time() const {
+        return frame_time;
+    }
+
+    Vector2 NullRenderBackend::get_screen_size() const {
+        return screen_size;
+    }
+
+    bool NullRenderBackend::is_resized() const {
+        return false;
+    }
+
+    void NullRenderBackend::begin_frame(const Camera2D &) {
+        captured_vertices.clear();
+    }
+
+    void NullRenderBackend::end_frame() {
+        flush_quads();
+        flush();
+        ++stats.frames;
+    }
+
+    // Hands out texture ids without keeping the pixels
+    Texture2D NullRenderBackend::load_texture(const Image &image) {
+        return {next_texture_id++, image.width, image.height, image.mipmaps, image.format};
+    }
+
+    void NullRenderBackend::set_texture(const unsigned int texture_id) {
+        if (texture_id == bound_texture) return;
+        flush_quads();
+        bound_texture = texture_id;
+        if (texture_id != 0) {
+            ++stats.texture_binds;
+        }
+    }
+
+    void NullRenderBackend::set_blend_mode(const int blend_mode) {
+        if (blend_mode == this->blend_mode) return;
+        flush_quads();
+        flush();
+        this->blend_mode = blend_mode;
+        ++stats.blend_mode_changes;
+    }
+
+    bool NullRenderBackend::reserve_vertices(const std::uint32_t vertex_count) {
+        if (quad_buffer_fill + vertex_count <= BATCH_VERTEX_LIMIT) return false;
+        flush_quads();
+        quad_buffer_fill = 0;
+        return true;
+    }
+
+    // Like the raylib backend, the shapes in the rlgl batch are drawn before a new run of quads
+    void NullRenderBackend::draw_quads(const std::span<const SpriteVertex> vertices) {
+        if (vertices.empty()) return;
+        const auto vertex_count = static_cast<std::uint32_t>(vertices.size());
+        if (quad_buffer_fill + vertex_count > BATCH_VERTEX_LIMIT) {
+            reserve_vertices(vertex_count);
+        }
+        if (pending_quad_vertices == 0) {
+            flush();
+        }
+        quad_buffer_fill += vertex_count;
+        pending_quad_vertices += vertex_count;
+        add_vertices(vertex_count);
+        if (capture_vertices) {
+            captured_vertices.insert(captured_vertices.end(), vertices.begin(), vertices.end());
+        }
+    }
+
+    // Same rule as rlgl: a rectangle that would not fit draws the batch first
+    void NullRenderBackend::draw_rectangle(const Rectangle &, Vector2, float, Color) {
+        flush_quads();
+        if (batch_vertices + 4 > BATCH_VERTEX_LIMIT) {
+            flush();
+        }
+        batch_vertices += 4;
+        add_vertices(4);
+        ++stats.rectangles;
+    }
+
+} // namespace rpg
@@ -0,0 +1,94 @@
+// null_render_backend.h
+// Purpose: Render backend without a window or GPU. It counts what the render systems submit,
+// emulating the raylib backend's quad buffer and rlgl batch so flushes match it, and can capture the vertex
+// stream of the last frame for comparisons. Every frame lasts a fixed time.
+
+#ifndef NULL_RENDER_BACKEND_H
+#define NULL_RENDER_BACKEND_H
+
+#include <cstdint>
+#include <vector>
+
+#include "render_backend.h"
+
+namespace rpg {
+
+    // Totals since the backend was created
+    struct RecordedRenderStats {
+        std::uint64_t frames = 0;
+        // Quads of draw_quads and draw_rectangle, and their vertices
+        std::uint64_t quads = 0;
+        std::uint64_t vertices = 0;
+        std::uint64_t rectangles = 0;
+        // Changes of the bound texture, not counting unbinds
+        std::uint64_t texture_binds = 0;
+        std::uint64_t blend_mode_changes = 0;
+        // Draw calls: runs of quads, and rlgl batches of rectangles
+        std::uint64_t batch_flushes = 0;
+    };
+
+    class NullRenderBackend final : public RenderBackend {
+        Vector2 screen_size;
+        float frame_time;
+        // should_close() turns true once this many frames ended
+        std::uint64_t frame_limit;
+
+        unsigned int next_texture_id = 1;
+        unsigned int bound_texture = 0;
+        int blend_mode = BLEND_ALPHA;
+        // Rectangles in the emulated rlgl batch
+        std::uint32_t batch_vertices = 0;
+        // Vertices in the emulated quad buffer, and the ones at its end not drawn yet
+        std::uint32_t quad_buffer_fill = 0;
+        std::uint32_t pending_quad_vertices = 0;
+
+        bool capture_vertices = false;
+        std::vector<SpriteVertex> captured_vertices;
+
+        RecordedRenderStats stats;
+
+        void flush();
+
+        void flush_quads();
+
+        void add_vertices(std::uint32_t vertex_count);
+
+    public:
+        explicit NullRenderBackend(std::uint64_t frame_limit, Vector2 screen_size = {800.0f, 600.0f},
+                                   float frame_time = 1.0f / 60.0f);
+
+        [[nodiscard]] bool should_close() const override;
+
+        [[nodiscard]] float get_frame_time() const override;
+
+        [[nodiscard]] Vector2 get_screen_size() const override;
+
+        [[nodiscard]] bool is_resized() const override;
+
+        void begin_frame(const Camera2D &camera) override;
+
+        void end_frame() override;
+
+        Texture2D load_texture(const Image &image) override;
+
+        void set_texture(unsigned int texture_id) override;
+
+        void set_blend_mode(int blend_mode) override;
+
+        bool reserve_vertices(std::uint32_t vertex_count) override;
+
+        void draw_quads(std::span<const SpriteVertex> vertices) override;
+
+        void draw_rectangle(const Rectangle &rectangle, Vector2 origin, float rotation, Color color) override;
+
+        // While enabled, draw_quads keeps its vertices until the next frame begins
+        void set_vertex_capture(const bool enabled) { capture_vertices = enabled; }
+
+        [[nodiscard]] const std::vector<SpriteVertex> &get_captured_vertices() const { return captured_vertices; }
+
+        [[nodiscard]] const RecordedRenderStats &get_stats() const { return stats; }
+    };
+
+} // namespace rpg
+
+#endif // NULL_RENDER_BACKEND_H
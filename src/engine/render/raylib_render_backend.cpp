@@ -0,0 +1,171 @@
+// raylib_render_backend.cpp
+// Purpose: raylib window and frame management, and quad submission through a vertex buffer
+// drawn next to the rlgl batch.
+
+#include "raylib_render_backend.h"
+
+#include <cstddef>
+#include <vector>
+
+#include "raymath.h"
+
+namespace rpg {
+
+    RaylibRenderBackend::RaylibRenderBackend(const int width, const int height, const char *title) {
+        SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+        InitWindow(width, height, title);
+        //SetTargetFPS(60);
+
+        // Two triangles per quad, in the corner order of SpriteVertex; indices are 16-bit, which
+        // BATCH_VERTEX_LIMIT fits in
+        std::vector<unsigned short> indices;
+        indices.reserve(BATCH_VERTEX_LIMIT / 4 * 6);
+        for (std::uint32_t vertex = 0; vertex < BATCH_VERTEX_LIMIT; vertex += 4) {
+            for (const std::uint32_t corner: {0u, 1u, 2u, 0u, 2u, 3u}) {
+                indices.push_back(static_cast<unsigned short>(vertex + corner));
+            }
+        }
+
+        quad_array = rlLoadVertexArray();
+        rlEnableVertexArray(quad_array);
+        quad_buffer = rlLoadVertexBuffer(nullptr, static_cast<int>(BATCH_VERTEX_LIMIT * sizeof(SpriteVertex)), true);
+        quad_indices = rlLoadVertexBufferElement(indices.data(), static_cast<int>(indices.size() * sizeof(unsigned short)), false);
+        bind_quad_buffer();
+        rlDisableVertexArray();
+    }
+
+    RaylibRenderBackend::~RaylibRenderBackend() {
+        rlUnloadVertexArray(quad_array);
+        rlUnloadVertexBuffer(quad_buffer);
+        rlUnloadVertexBuffer(quad_indices);
+        CloseWindow();
+    }
+
+    // One attribute per SpriteVertex field, at the default shader's locations. With a VAO this is
+    // recorded once; without one it is set again for every draw.
+    void RaylibRenderBackend::bind_quad_buffer() const {
+        const int *locations = rlGetShaderLocsDefault();
+        constexpr int stride = sizeof(SpriteVertex);
+
+        rlEnableVertexBuffer(quad_buffer);
+        rlSetVertexAttribute(locations[RL_SHADER_LOC_VERTEX_POSITION], 2, RL_FLOAT, false, stride,
+                             offsetof(SpriteVertex, position));
+        rlEnableVertexAttribute(locations[RL_SHADER_LOC_VERTEX_POSITION]);
+        rlSetVertexAttribute(locations[RL_SHADER_LOC_VERTEX_TEXCOORD01], 2, RL_FLOAT, false, stride,
+                             offsetof(SpriteVertex, uv));
+        rlEnableVertexAttribute(locations[RL_SHADER_LOC_VERTEX_TEXCOORD01]);
+        rlSetVertexAttribute(locations[RL_SHADER_LOC_VERTEX_COLOR], 4, RL_UNSIGNED_BYTE, true, stride,
+                             offsetof(SpriteVertex, color));
+        rlEnableVertexAttribute(locations[RL_SHADER_LOC_VERTEX_COLOR]);
+        rlEnableVertexBufferElement(quad_indices);
+    }
+
+    // Same uniforms as rlgl sets for its own batch: the current camera transform, a white tint
+    // and texture unit 0
+    void RaylibRenderBackend::flush_quads() {
+        if (pending_vertices == 0) return;
+
+        const int *locations = rlGetShaderLocsDefault();
+        constexpr float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+        constexpr int texture_unit = 0;
+
+        rlEnableShader(rlGetShaderIdDefault());
+        rlSetUniformMatrix(locations[RL_SHADER_LOC_MATRIX_MVP], MatrixMultiply(rlGetMatrixModelview(), rlGetMatrixProjection()));
+        rlSetUniform(locations[RL_SHADER_LOC_COLOR_DIFFUSE], white, RL_SHADER_UNIFORM_VEC4, 1);
+        rlSetUniform(locations[RL_SHADER_LOC_MAP_DIFFUSE], &texture_unit, RL_SHADER_UNIFORM_INT, 1);
+
+        rlActiveTextureSlot(0);
+        rlEnableTexture(texture != 0 ? texture : rlGetTextureIdDefault());
+        if (!rlEnableVertexArray(quad_array)) {
+            bind_quad_buffer();
+        }
+
+        const std::uint32_t first_vertex = buffer_fill - pending_vertices;
+        rlDrawVertexArrayElements(static_cast<int>(first_vertex / 4 * 6), static_cast<int>(pending_vertices / 4 * 6), nullptr);
+
+        rlDisableVertexArray();
+        rlDisableVertexBuffer();
+        rlDisableVertexBufferElement();
+        rlDisableTexture();
+        rlDisableShader();
+        pending_vertices = 0;
+    }
+
+    bool RaylibRenderBackend::should_close() const {
+        return WindowShouldClose();
+    }
+
+    float RaylibRenderBackend::get_frame_time() const {
+        return GetFrameTime();
+    }
+
+    Vector2 RaylibRenderBackend::get_screen_size() const {
+        return {static_cast<float>(GetScreenWidth()), static_cast<float>(GetScreenHeight())};
+    }
+
+    bool RaylibRenderBackend::is_resized() const {
+        return IsWindowResized();
+    }
+
+    void RaylibRenderBackend::begin_frame(const Camera2D &camera) {
+        BeginDrawing();
+        ClearBackground(BLACK);
+        BeginMode2D(camera);
+    }
+
+    void RaylibRenderBackend::end_frame() {
+        flush_quads();
+        EndMode2D();
+        DrawFPS(10, 10);
+        EndDrawing();
+    }
+
+    Texture2D RaylibRenderBackend::load_texture(const Image &image) {
+        return LoadTextureFromImage(image);
+    }
+
+    void RaylibRenderBackend::set_texture(const unsigned int texture_id) {
+        if (texture_id == texture) return;
+        flush_quads();
+        texture = texture_id;
+    }
+
+    // rlSetBlendMode draws the rlgl batch and changes the GL state right away, so the pending
+    // quads must be drawn before it
+    void RaylibRenderBackend::set_blend_mode(const int blend_mode) {
+        flush_quads();
+        rlSetBlendMode(blend_mode);
+    }
+
+    bool RaylibRenderBackend::reserve_vertices(const std::uint32_t vertex_count) {
+        if (buffer_fill + vertex_count <= BATCH_VERTEX_LIMIT) return false;
+        flush_quads();
+        buffer_fill = 0;
+        return true;
+    }
+
+    // Copies prebuilt quads into the vertex buffer with one upload; consecutive calls with the same
+    // texture extend the same draw call. Shapes rlgl holds from before are drawn first, so they stay
+    // under the quads.
+    void RaylibRenderBackend::draw_quads(const std::span<const SpriteVertex> vertices) {
+        if (vertices.empty()) return;
+        if (buffer_fill + vertices.size() > BATCH_VERTEX_LIMIT) {
+            reserve_vertices(static_cast<std::uint32_t>(vertices.size()));
+        }
+        if (pending_vertices == 0) {
+            rlDrawRenderBatchActive();
+        }
+
+        rlUpdateVertexBuffer(quad_buffer, vertices.data(), static_cast<int>(vertices.size_bytes()),
+                             static_cast<int>(buffer_fill * sizeof(SpriteVertex)));
+        buffer_fill += static_cast<std::uint32_t>(vertices.size());
+        pending_vertices += static_cast<std::uint32_t>(vertices.size());
+    }
+
+    void RaylibRenderBackend::draw_rectangle(const Rectangle &rectangle, const Vector2 origin, const float rotation,
+                                             const Color color) {
+        flush_quads();
+        DrawRectanglePro(rectangle, origin, rotation, color);
+    }
+
+} // namespace rpg
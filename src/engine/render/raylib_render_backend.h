@@ -0,0 +1,65 @@
+// raylib_render_backend.h
+// Purpose: Render backend drawing to a raylib window. The window lives as long as the backend.
+// Sprite quads skip rlgl's immediate-mode batch: they are copied into one dynamic vertex buffer
+// as they come, and every run of one texture is drawn with a single indexed draw call.
+
+#ifndef RAYLIB_RENDER_BACKEND_H
+#define RAYLIB_RENDER_BACKEND_H
+
+#include <cstdint>
+
+#include "render_backend.h"
+
+namespace rpg {
+
+    class RaylibRenderBackend final : public RenderBackend {
+        // Vertex array of the quad buffer (0 without VAO support), the interleaved SpriteVertex
+        // buffer and the indices of BATCH_VERTEX_LIMIT / 4 quads
+        unsigned int quad_array = 0;
+        unsigned int quad_buffer = 0;
+        unsigned int quad_indices = 0;
+
+        unsigned int texture = 0;
+        // Vertices written to the quad buffer since it was started over, and the ones at its end
+        // that are not drawn yet
+        std::uint32_t buffer_fill = 0;
+        std::uint32_t pending_vertices = 0;
+
+        void bind_quad_buffer() const;
+
+        // Draws the pending quads with the current texture and the default shader
+        void flush_quads();
+
+    public:
+        RaylibRenderBackend(int width, int height, const char *title);
+
+        ~RaylibRenderBackend() override;
+
+        [[nodiscard]] bool should_close() const override;
+
+        [[nodiscard]] float get_frame_time() const override;
+
+        [[nodiscard]] Vector2 get_screen_size() const override;
+
+        [[nodiscard]] bool is_resized() const override;
+
+        void begin_frame(const Camera2D &camera) override;
+
+        void end_frame() override;
+
+        Texture2D load_texture(const Image &image) override;
+
+        void set_texture(unsigned int texture_id) override;
+
+        void set_blend_mode(int blend_mode) override;
+
+        bool reserve_vertices(std::uint32_t vertex_count) override;
+
+        void draw_quads(std::span<const SpriteVertex> vertices) override;
+
+        void draw_rectangle(const Rectangle &rectangle, Vector2 origin, float rotation, Color color) override;
+    };
+
+} // namespace rpg
+
+#endif // RAYLIB_RENDER_BACKEND_H
@@ -0,0 +1,66 @@
+// render_backend.h
+// Purpose: Common interface under the render systems and the frame loop. RaylibRenderBackend
+// draws to a window through raylib and rlgl; NullRenderBackend only records what it is asked to
+// draw, so the whole pipeline can run without a window or GPU.
+
+#ifndef RENDER_BACKEND_H
+#define RENDER_BACKEND_H
+
+#include <cstdint>
+#include <span>
+
+#include "raylib.h"
+#include "rlgl.h"
+#include "sprite_vertex.h"
+
+namespace rpg {
+
+    class RenderBackend {
+    public:
+        virtual ~RenderBackend() = default;
+
+        // Frame loop
+        [[nodiscard]] virtual bool should_close() const = 0;
+
+        // Seconds the last frame took
+        [[nodiscard]] virtual float get_frame_time() const = 0;
+
+        [[nodiscard]] virtual Vector2 get_screen_size() const = 0;
+
+        [[nodiscard]] virtual bool is_resized() const = 0;
+
+        // Clears the screen and starts drawing the world through the camera
+        virtual void begin_frame(const Camera2D &camera) = 0;
+
+        virtual void end_frame() = 0;
+
+        // Uploads an image; the image stays owned by the caller
+        virtual Texture2D load_texture(const Image &image) = 0;
+
+        // Texture of the next quads; 0 unbinds it. Quads submitted with another texture are drawn
+        // first.
+        virtual void set_texture(unsigned int texture_id) = 0;
+
+        // Draws the pending quads first
+        virtual void set_blend_mode(int blend_mode) = 0;
+
+        // Draws the pending quads and starts the quad buffer over if `vertex_count` more vertices
+        // would not fit in it, keeping the texture; returns true if it started over
+        virtual bool reserve_vertices(std::uint32_t vertex_count) = 0;
+
+        // Appends quads of four vertices each to the quad buffer, which they must fit in (see
+        // reserve_vertices). They are drawn in one call with the quads before them when the texture
+        // or blend mode changes, the buffer starts over, a rectangle is drawn or the frame ends.
+        virtual void draw_quads(std::span<const SpriteVertex> vertices) = 0;
+
+        // Rectangle rotated around `origin`, relative to its top-left corner
+        virtual void draw_rectangle(const Rectangle &rectangle, Vector2 origin, float rotation, Color color) = 0;
+
+        // Vertices the quad buffer holds before it must start over: as many as rlgl's default batch,
+        // which keeps their indices 16-bit (default: 32768).
+        static constexpr std::uint32_t BATCH_VERTEX_LIMIT = RL_DEFAULT_BATCH_BUFFER_ELEMENTS * 4;
+    };
+
+} // namespace rpg
+
+#endif // RENDER_BACKEND_H
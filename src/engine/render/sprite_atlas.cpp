@@ -0,0 +1,30 @@
+// sprite_atlas.cpp
+// Purpose: Name interning and region storage of the sprite atlas.
+
+#include "sprite_atlas.h"
+
+namespace rpg {
+
+    SpriteHandle SpriteAtlas::intern(const std::string &name) {
+        const auto [it, inserted] = handles.try_emplace(name, static_cast<SpriteHandle>(regions.size()));
+        if (inserted) {
+            regions.emplace_back();
+        }
+        return it->second;
+    }
+
+    SpriteHandle SpriteAtlas::find(const std::string &name) const {
+        const auto it = handles.find(name);
+        return it != handles.end() ? it->second : EMPTY_SPRITE;
+    }
+
+    void SpriteAtlas::set_region(const SpriteHandle handle, const SpriteRegion &region) {
+        if (handle == EMPTY_SPRITE || handle >= regions.size()) return;
+        regions[handle] = region;
+    }
+
+    SpriteHandle get_sprite_handle(entt::registry &registry, const std::string &name) {
+        return registry.ctx().emplace<SpriteAtlas>().intern(name);
+    }
+
+} // namespace rpg
@@ -0,0 +1,54 @@
+// sprite_atlas.h
+// Purpose: Regions of the texture atlas, stored in the registry context. Sprite names are
+// resolved into SpriteHandles once, when a sprite is spawned or the atlas is loaded, so
+// rendering indexes a contiguous table instead of hashing strings.
+
+#ifndef SPRITE_ATLAS_H
+#define SPRITE_ATLAS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "entt/entt.hpp"
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    struct SpriteRegion {
+        // Size in pixels; a negative size draws the sprite flipped along that axis
+        float width = 0.0f;
+        float height = 0.0f;
+        // Normalized UV rectangle on its page
+        float sx = 0.0f, sy = 0.0f, sw = 0.0f, sh = 0.0f;
+        std::uint32_t page = 0;
+    };
+
+    class SpriteAtlas {
+        // Indexed by handle; EMPTY_SPRITE is an empty region, so any handle can be drawn
+        std::vector<SpriteRegion> regions{SpriteRegion{}};
+        std::unordered_map<std::string, SpriteHandle> handles;
+
+    public:
+        // Handle of a name, registered with an empty region if the atlas does not have it yet
+        SpriteHandle intern(const std::string &name);
+
+        // Handle of a name, or EMPTY_SPRITE if it was never interned
+        [[nodiscard]] SpriteHandle find(const std::string &name) const;
+
+        void set_region(SpriteHandle handle, const SpriteRegion &region);
+
+        [[nodiscard]] const SpriteRegion &get(const SpriteHandle handle) const {
+            return regions[handle];
+        }
+
+        [[nodiscard]] std::size_t size() const { return regions.size(); }
+    };
+
+    // Resolves a sprite name through the atlas in the registry context, creating the atlas if needed
+    SpriteHandle get_sprite_handle(entt::registry &registry, const std::string &name);
+
+} // namespace rpg
+
+#endif // SPRITE_ATLAS_H
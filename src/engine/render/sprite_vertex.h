@@ -0,0 +1,21 @@
+// sprite_vertex.h
+// Purpose: Interleaved vertex of a sprite quad, as built on the CPU before submission.
+// Quads are four vertices in the order top-left, bottom-left, bottom-right, top-right,
+// matching RL_QUADS.
+
+#ifndef SPRITE_VERTEX_H
+#define SPRITE_VERTEX_H
+
+#include "raylib.h"
+
+namespace rpg {
+
+    struct SpriteVertex {
+        Vector2 position;
+        Vector2 uv;
+        Color color;
+    };
+
+} // namespace rpg
+
+#endif // SPRITE_VERTEX_H
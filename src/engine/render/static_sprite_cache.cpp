@@ -0,0 +1,159 @@
+// static_sprite_cache.cpp
+// Purpose: Chunk binning and vertex rebuilds of StaticSpriteCache.
+
+#include "static_sprite_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    StaticSpriteCache::StaticSpriteCache(const float chunk_size): chunk_size(chunk_size) {
+    }
+
+    void StaticSpriteCache::invalidate_all() {
+        for (auto &chunk: chunks) {
+            chunk.dirty = true;
+        }
+    }
+
+    // Chunks are created on first use and kept once empty, so the indices in entity_slots stay valid
+    std::uint32_t StaticSpriteCache::get_chunk(const Vector2 position) {
+        const auto column = static_cast<std::int32_t>(std::floor(position.x / chunk_size));
+        const auto row = static_cast<std::int32_t>(std::floor(position.y / chunk_size));
+        const std::uint64_t key = static_cast<std::uint64_t>(static_cast<std::uint32_t>(column)) << 32 |
+                                  static_cast<std::uint32_t>(row);
+
+        const auto [it, inserted] = chunk_lookup.try_emplace(key, static_cast<std::uint32_t>(chunks.size()));
+        if (inserted) {
+            StaticChunk chunk;
+            chunk.column = column;
+            chunk.row = row;
+            chunks.push_back(std::move(chunk));
+        }
+        return it->second;
+    }
+
+    void StaticSpriteCache::remove_sprite(const entt::entity entity) {
+        const auto slot_index = static_cast<std::size_t>(entt::to_entity(entity));
+        if (slot_index >= entity_slots.size()) return;
+
+        auto &slot = entity_slots[slot_index];
+        if (slot.entity != entity || slot.chunk == NO_CHUNK) return;
+
+        auto &chunk = chunks[slot.chunk];
+        chunk.entities.erase(std::find(chunk.entities.begin(), chunk.entities.end(), entity));
+        chunk.dirty = true;
+
+        slot = {};
+        --sprite_count;
+    }
+
+    void StaticSpriteCache::add_sprite(const entt::entity entity, const Vector2 position) {
+        const auto slot_index = static_cast<std::size_t>(entt::to_entity(entity));
+        if (slot_index >= entity_slots.size()) {
+            entity_slots.resize(slot_index + 1);
+        }
+
+        auto &slot = entity_slots[slot_index];
+        if (slot.entity == entity && slot.chunk != NO_CHUNK) return;
+
+        const std::uint32_t chunk = get_chunk(position);
+        chunks[chunk].entities.push_back(entity);
+        chunks[chunk].dirty = true;
+
+        slot = {entity, chunk};
+        ++sprite_count;
+    }
+
+    // Builds the quads in sprite order, then groups them by key with a stable sort so every
+    // group keeps the order the sprites were added in
+    void StaticSpriteCache::rebuild_chunk(StaticChunk &chunk, const QuadBuilder &build_quad) {
+        quad_vertices.clear();
+        quad_keys.clear();
+        for (const auto entity: chunk.entities) {
+            quad_keys.push_back(build_quad(entity, quad_vertices));
+        }
+
+        quad_order.resize(quad_keys.size());
+        std::iota(quad_order.begin(), quad_order.end(), 0u);
+        std::stable_sort(quad_order.begin(), quad_order.end(), [this](const std::uint32_t a, const std::uint32_t b) {
+            return quad_keys[a] < quad_keys[b];
+        });
+
+        chunk.vertices.clear();
+        chunk.batches.clear();
+        for (const auto quad: quad_order) {
+            const auto begin = static_cast<std::uint32_t>(chunk.vertices.size());
+            if (chunk.batches.empty() || chunk.batches.back().key != quad_keys[quad]) {
+                chunk.batches.push_back({quad_keys[quad], begin, 0});
+            }
+            chunk.vertices.insert(chunk.vertices.end(), quad_vertices.begin() + quad * 4, quad_vertices.begin() + quad * 4 + 4);
+            chunk.batches.back().count += 4;
+        }
+
+        if (chunk.vertices.empty()) {
+            chunk.bounds = {0.0f, 0.0f, 0.0f, 0.0f};
+        } else {
+            float min_x = chunk.vertices[0].position.x, min_y = chunk.vertices[0].position.y;
+            float max_x = min_x, max_y = min_y;
+            for (const auto &vertex: chunk.vertices) {
+                min_x = std::min(min_x, vertex.position.x);
+                min_y = std::min(min_y, vertex.position.y);
+                max_x = std::max(max_x, vertex.position.x);
+                max_y = std::max(max_y, vertex.position.y);
+            }
+            chunk.bounds = {min_x, min_y, max_x - min_x, max_y - min_y};
+        }
+
+        chunk.dirty = false;
+    }
+
+    // Every changed sprite is first taken out of the chunk it was in, then the ones that still
+    // belong in the cache are added back where they are now. Doing all removals first keeps a
+    // destroyed entity and a new one reusing its slot in the same frame from mixing up.
+    void StaticSpriteCache::update(const entt::registry &registry, const QuadBuilder &build_quad) {
+        for (const auto entity: pending_entities) {
+            remove_sprite(entity);
+        }
+
+        for (const auto entity: pending_entities) {
+            if (!registry.valid(entity) || !registry.all_of<Sprite, Transform>(entity) ||
+                registry.all_of<MovementData>(entity)) {
+                continue;
+            }
+            add_sprite(entity, registry.get<Transform>(entity).position);
+        }
+        pending_entities.clear();
+
+        rebuilt_chunks = 0;
+        for (auto &chunk: chunks) {
+            if (chunk.dirty) {
+                rebuild_chunk(chunk, build_quad);
+                ++rebuilt_chunks;
+            }
+        }
+    }
+
+    // There are only (world area / chunk area) chunks, few enough to test each one's bounds
+    void StaticSpriteCache::query(const Rectangle &area, std::vector<const StaticChunk *> &visible) const {
+        visible.clear();
+        // Also rejects the NaN area of a camera that has no zoom yet
+        if (!(area.width > 0.0f && area.height > 0.0f)) return;
+
+        for (const auto &chunk: chunks) {
+            if (chunk.vertices.empty()) continue;
+
+            const Rectangle &bounds = chunk.bounds;
+            if (bounds.x <= area.x + area.width && bounds.x + bounds.width >= area.x &&
+                bounds.y <= area.y + area.height && bounds.y + bounds.height >= area.y) {
+                visible.push_back(&chunk);
+            }
+        }
+    }
+
+} // namespace rpg
@@ -0,0 +1,114 @@
+// static_sprite_cache.h
+// Purpose: Prebuilt vertices of the sprites that never move (no MovementData), grouped into
+// square chunks of the world. A chunk keeps the quads of its sprites in one vertex array, so
+// drawing it is a plain copy, and it is only rebuilt when one of its sprites is added, removed
+// or edited. The cache itself makes no graphics calls: it builds vertices through a callback and
+// can be updated and queried without a window.
+
+#ifndef STATIC_SPRITE_CACHE_H
+#define STATIC_SPRITE_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "raylib.h"
+#include "entt/entt.hpp"
+#include "sprite_vertex.h"
+
+namespace rpg {
+
+    struct StaticChunk {
+        // Chunk coordinates in the world grid
+        std::int32_t column = 0;
+        std::int32_t row = 0;
+
+        // Run of vertices sharing a draw key
+        struct Batch {
+            std::uint32_t key;
+            std::uint32_t begin;
+            std::uint32_t count;
+        };
+
+        // Sprites binned in the chunk by position, in the order they were added
+        std::vector<entt::entity> entities;
+        // Quads of the sprites grouped by draw key, each group in the order of `entities`
+        std::vector<SpriteVertex> vertices;
+        std::vector<Batch> batches;
+        // Bounds of the vertices, which may reach past the chunk's cell
+        Rectangle bounds{0.0f, 0.0f, 0.0f, 0.0f};
+
+        bool dirty = false;
+    };
+
+    class StaticSpriteCache {
+    public:
+        // Appends the four vertices of a sprite's quad and returns its draw key: quads with the same
+        // key can be drawn in one go (the renderer uses the atlas page and blend mode)
+        using QuadBuilder = std::function<std::uint32_t(entt::entity entity, std::vector<SpriteVertex> &vertices)>;
+
+        explicit StaticSpriteCache(float chunk_size = DEFAULT_CHUNK_SIZE);
+
+        // Called from registry signals when a sprite, its transform or its MovementData changed; the
+        // entity is moved between chunks on the next update
+        void mark_changed(entt::entity entity) { pending_entities.push_back(entity); }
+
+        // Re-bins the changed sprites, then rebuilds the chunks that gained, lost or changed one.
+        // A sprite belongs in the cache while it has Sprite and Transform and no MovementData.
+        void update(const entt::registry &registry, const QuadBuilder &build_quad);
+
+        // Forces every chunk to be rebuilt on the next update, e.g. after the UVs were reloaded
+        void invalidate_all();
+
+        // Non-empty chunks whose vertices may overlap `area`
+        void query(const Rectangle &area, std::vector<const StaticChunk *> &visible) const;
+
+        [[nodiscard]] std::uint32_t get_sprite_count() const { return sprite_count; }
+
+        [[nodiscard]] std::uint32_t get_chunk_count() const { return static_cast<std::uint32_t>(chunks.size()); }
+
+        // Chunks rebuilt by the last update
+        [[nodiscard]] std::uint32_t get_rebuilt_chunks() const { return rebuilt_chunks; }
+
+    private:
+        // Chunk of a cached sprite, remembered to find it again once the sprite moved or is gone
+        struct ChunkSlot {
+            entt::entity entity = entt::null;
+            std::uint32_t chunk = NO_CHUNK;
+        };
+
+        float chunk_size;
+        std::vector<StaticChunk> chunks;
+        // Index into `chunks` of each chunk coordinate pair
+        std::unordered_map<std::uint64_t, std::uint32_t> chunk_lookup;
+
+        // Indexed by the entity part of the identifier
+        std::vector<ChunkSlot> entity_slots;
+        std::vector<entt::entity> pending_entities;
+
+        std::uint32_t sprite_count = 0;
+        std::uint32_t rebuilt_chunks = 0;
+
+        void remove_sprite(entt::entity entity);
+
+        void add_sprite(entt::entity entity, Vector2 position);
+
+        std::uint32_t get_chunk(Vector2 position);
+
+        // Quads of the chunk being rebuilt, before they are grouped by key
+        std::vector<SpriteVertex> quad_vertices;
+        std::vector<std::uint32_t> quad_keys;
+        std::vector<std::uint32_t> quad_order;
+
+        void rebuild_chunk(StaticChunk &chunk, const QuadBuilder &build_quad);
+
+        // Side of a chunk in world units (default: 512.0f).
+        static constexpr float DEFAULT_CHUNK_SIZE = 512.0f;
+        // Marks a sprite that is not in any chunk.
+        static constexpr std::uint32_t NO_CHUNK = 0xFFFFFFFF;
+    };
+
+} // namespace rpg
+
+#endif // STATIC_SPRITE_CACHE_H
@@ -0,0 +1,101 @@
+// view_culler.cpp
+// Purpose: Visible area of a Camera2D and the grid queries of ViewCuller.
+
+#include "view_culler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace rpg {
+
+    Rectangle get_visible_area(const Camera2D &camera, const float screen_width, const float screen_height) {
+        const Vector2 corners[4] = {
+            GetScreenToWorld2D({0.0f, 0.0f}, camera),
+            GetScreenToWorld2D({screen_width, 0.0f}, camera),
+            GetScreenToWorld2D({0.0f, screen_height}, camera),
+            GetScreenToWorld2D({screen_width, screen_height}, camera)
+        };
+
+        float min_x = corners[0].x, min_y = corners[0].y;
+        float max_x = corners[0].x, max_y = corners[0].y;
+        for (const auto &corner: corners) {
+            min_x = std::min(min_x, corner.x);
+            min_y = std::min(min_y, corner.y);
+            max_x = std::max(max_x, corner.x);
+            max_y = std::max(max_y, corner.y);
+        }
+        return {min_x, min_y, max_x - min_x, max_y - min_y};
+    }
+
+    ViewCuller::Drawables::Drawables(const float cell_size): grid(cell_size) {
+    }
+
+    void ViewCuller::Drawables::clear() {
+        entities.clear();
+        positions.clear();
+        radii.clear();
+        max_radius = 0.0f;
+    }
+
+    void ViewCuller::Drawables::add(const entt::entity entity, const Vector2 position, const float radius) {
+        entities.push_back(entity);
+        positions.push_back(position);
+        radii.push_back(radius);
+        max_radius = std::max(max_radius, radius);
+    }
+
+    // Drawables are binned by position only, so the cells searched are grown by the largest reach
+    // and every candidate is then tested with its own
+    void ViewCuller::Drawables::query(const Rectangle &area, std::vector<entt::entity> &visible) const {
+        if (entities.empty()) return;
+
+        const int margin = static_cast<int>(std::ceil(max_radius / grid.get_effective_cell_size()));
+        grid.for_each_item(area, margin, [&](const std::uint32_t item) {
+            const Vector2 &position = positions[item];
+            const float radius = radii[item];
+
+            if (position.x + radius >= area.x && position.x - radius <= area.x + area.width &&
+                position.y + radius >= area.y && position.y - radius <= area.y + area.height) {
+                visible.push_back(entities[item]);
+            }
+        });
+    }
+
+    ViewCuller::ViewCuller(const float cell_size)
+        : static_drawables(cell_size), moving_drawables(cell_size) {
+    }
+
+    void ViewCuller::clear_statics() {
+        static_drawables.clear();
+    }
+
+    void ViewCuller::add_static(const entt::entity entity, const Vector2 position, const float radius) {
+        static_drawables.add(entity, position, radius);
+    }
+
+    void ViewCuller::clear_moving() {
+        moving_drawables.clear();
+    }
+
+    void ViewCuller::add_moving(const entt::entity entity, const Vector2 position, const float radius) {
+        moving_drawables.add(entity, position, radius);
+    }
+
+    void ViewCuller::update() {
+        if (statics_dirty) {
+            static_drawables.grid.build(static_drawables.positions);
+            statics_dirty = false;
+        }
+        moving_drawables.grid.update(moving_drawables.positions);
+    }
+
+    void ViewCuller::query(const Rectangle &area, std::vector<entt::entity> &visible) const {
+        visible.clear();
+        // Also rejects the NaN area of a camera that has no zoom yet
+        if (!(area.width > 0.0f && area.height > 0.0f)) return;
+
+        static_drawables.query(area, visible);
+        moving_drawables.query(area, visible);
+    }
+
+} // namespace rpg
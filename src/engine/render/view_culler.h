@@ -0,0 +1,101 @@
+// view_culler.h
+// Purpose: Spatial index of the drawables of a renderer, queried with the world rectangle the
+// camera shows. Drawables are binned by position in two SpatialGrids, like the collision grid:
+// the ones without MovementData never move on their own, so their grid is only rebuilt when one of
+// them is added, removed or edited; the moving ones are re-binned every frame, which only moves the
+// grid items of the ones that changed cell.
+
+#ifndef VIEW_CULLER_H
+#define VIEW_CULLER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "raylib.h"
+#include "entt/entt.hpp"
+#include "engine/collision/spatial_grid.h"
+
+namespace rpg {
+
+    // Per-frame culling results of the renderers, stored in the registry context
+    struct RenderStats {
+        std::uint32_t drawn_sprites = 0;
+        std::uint32_t culled_sprites = 0;
+        std::uint32_t drawn_shapes = 0;
+        std::uint32_t culled_shapes = 0;
+        // Chunks of static sprites drawn this frame, and rebuilt because one of their sprites changed
+        std::uint32_t drawn_chunks = 0;
+        std::uint32_t rebuilt_chunks = 0;
+        // Atlas page binds and blend mode changes of the sprite renderer; each one draws the quads
+        // submitted before it
+        std::uint32_t texture_switches = 0;
+        std::uint32_t blend_mode_switches = 0;
+        // Vertices the sprite renderer submitted, and the draw calls they took (one per run of a
+        // texture and blend mode, split where the backend's quad buffer started over)
+        std::uint32_t sprite_vertices = 0;
+        std::uint32_t batch_flushes = 0;
+    };
+
+    // World rectangle shown by the camera on a screen of the given size; for a rotated camera, the
+    // bounds of the rotated view
+    Rectangle get_visible_area(const Camera2D &camera, float screen_width, float screen_height);
+
+    class ViewCuller {
+        // Drawables of one grid: where each one is drawn and how far from there it can reach
+        struct Drawables {
+            SpatialGrid grid;
+            std::vector<entt::entity> entities;
+            std::vector<Vector2> positions;
+            std::vector<float> radii;
+            float max_radius = 0.0f;
+
+            explicit Drawables(float cell_size);
+
+            void clear();
+
+            void add(entt::entity entity, Vector2 position, float radius);
+
+            void query(const Rectangle &area, std::vector<entt::entity> &visible) const;
+        };
+
+        Drawables static_drawables;
+        Drawables moving_drawables;
+        bool statics_dirty = true;
+
+    public:
+        explicit ViewCuller(float cell_size = DEFAULT_CELL_SIZE);
+
+        // Called by the renderer when a drawable without MovementData was added, removed or edited
+        void invalidate_statics() { statics_dirty = true; }
+
+        [[nodiscard]] bool needs_statics() const { return statics_dirty; }
+
+        // Refilled only when needs_statics(), then kept until the next invalidation
+        void clear_statics();
+
+        void add_static(entt::entity entity, Vector2 position, float radius);
+
+        // Refilled every frame
+        void clear_moving();
+
+        void add_moving(entt::entity entity, Vector2 position, float radius);
+
+        // Bins the drawables added since the last update
+        void update();
+
+        // Drawables that may overlap `area`: the static ones first, then the moving ones, so
+        // moving bodies are drawn over the scenery
+        void query(const Rectangle &area, std::vector<entt::entity> &visible) const;
+
+        [[nodiscard]] std::uint32_t size() const {
+            return static_cast<std::uint32_t>(static_drawables.entities.size() + moving_drawables.entities.size());
+        }
+
+    private:
+        // Cell size of both grids, in world units (default: 256.0f).
+        static constexpr float DEFAULT_CELL_SIZE = 256.0f;
+    };
+
+} // namespace rpg
+
+#endif // VIEW_CULLER_H
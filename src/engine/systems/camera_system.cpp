@@ -4,11 +4,12 @@
 
 #include "camera_system.h"
 
+#include "engine/fixed_timestep.h"
 #include "engine/components/components.h"
 
 namespace rpg {
 
-    CameraSystem::CameraSystem(entt::registry *registry): System(registry) {
+    CameraSystem::CameraSystem(entt::registry *registry, const RenderBackend *backend): System(registry), backend(backend) {
     }
 
     void CameraSystem::run(float dt) {
@@ -17,29 +18,29 @@ namespace rpg {
         const auto entity = *view.begin();
 
         const auto &transform = view.get<Transform>(entity);
+        // Follows the player where it is drawn, not where the last step left it
+        const Vector2 position = get_render_position(*registry, entity, transform);
 
         if (!is_synced) {
-            const auto new_width = static_cast<float>(GetScreenWidth());
-            const auto new_height = static_cast<float>(GetScreenHeight());
-            camera.target = transform.position;
-            camera.offset = (Vector2){new_width / 2.0f, new_height / 2.0f};
+            const Vector2 screen_size = backend->get_screen_size();
+            camera.target = position;
+            camera.offset = (Vector2){screen_size.x / 2.0f, screen_size.y / 2.0f};
             camera.rotation = 0.0f;
             camera.zoom = 2.0f;
 
             is_synced = true;
         }
-        if (IsWindowResized())
+        if (backend->is_resized())
         {
-            const auto new_width = static_cast<float>(GetScreenWidth());
-            const auto new_height = static_cast<float>(GetScreenHeight());
+            const Vector2 screen_size = backend->get_screen_size();
 
-            camera.offset = (Vector2){ new_width / 2.0f, new_height / 2.0f };
+            camera.offset = (Vector2){ screen_size.x / 2.0f, screen_size.y / 2.0f };
         }
 
 
         camera.target = {
-            std::lerp(camera.target.x, transform.position.x, 0.2f),
-            std::lerp(camera.target.y, transform.position.y, 0.2f)
+            std::lerp(camera.target.x, position.x, 0.2f),
+            std::lerp(camera.target.y, position.y, 0.2f)
         };
     }
 } // rpg
@@ -7,14 +7,17 @@
 #include "system.h"
 #include "raylib.h"
 #include "entt/entt.hpp"
+#include "engine/render/render_backend.h"
 
 namespace rpg {
     class CameraSystem final : public System {
         Camera2D camera{0};
         bool is_synced = false;
+        // Source of the screen size
+        const RenderBackend *backend;
 
     public:
-        explicit CameraSystem(entt::registry *registry);
+        CameraSystem(entt::registry *registry, const RenderBackend *backend);
 
         void run(float dt) override;
 
@@ -2,109 +2,380 @@
 // Author: Jhone
 // Created: 16/08/2024
 // Purpose: Detects 2D collisions between entities with BoxCollider2D
-// and Transform components using a spatial hash grid for efficiency.
+// and Transform components. Colliders are snapshotted into SoA proxies and
+// handed to a runtime-selectable broadphase; the resulting pairs are published
+// to the ContactStream in the registry context.
 
 #include "collision_detection_system.h"
 
-#include <iostream>
+#include <algorithm>
 #include <cmath>
-#include <execution>
-#include <thread>
+#include <iostream>
+#include <limits>
+#include <utility>
 #include <vector>
-#include <unordered_set>
-#include <mutex>
-#include <numeric>
 
 namespace rpg {
-    CollisionDetectionSystem::CollisionDetectionSystem(entt::registry *registry)
+    CollisionDetectionSystem::CollisionDetectionSystem(entt::registry *registry, const BroadphaseType broadphase_type)
         : System(registry) {
+        if (!registry->ctx().contains<BroadphaseSettings>()) {
+            registry->ctx().emplace<BroadphaseSettings>().type = broadphase_type;
+        }
+        if (!registry->ctx().contains<ContactStream>()) {
+            registry->ctx().emplace<ContactStream>();
+        }
+        if (!registry->ctx().contains<SpatialQuery>()) {
+            registry->ctx().emplace<SpatialQuery>();
+        }
+        if (!registry->ctx().contains<BroadphaseStats>()) {
+            registry->ctx().emplace<BroadphaseStats>();
+        }
+        sync_broadphase_settings();
+
+        registry->on_construct<BoxCollider2D>().connect<&CollisionDetectionSystem::on_collider_changed>(this);
+        registry->on_update<BoxCollider2D>().connect<&CollisionDetectionSystem::on_collider_updated>(this);
+        registry->on_destroy<BoxCollider2D>().connect<&CollisionDetectionSystem::on_collider_changed>(this);
+        registry->on_update<Transform>().connect<&CollisionDetectionSystem::on_transform_changed>(this);
+        registry->on_construct<Sleeping>().connect<&CollisionDetectionSystem::on_sleep_changed>(this);
+        registry->on_destroy<Sleeping>().connect<&CollisionDetectionSystem::on_sleep_changed>(this);
     }
 
-    // Calculates the grid cell (x, y) in which a position falls
-    std::pair<int, int> CollisionDetectionSystem::get_hash_grid_cell(const float x, const float y) const {
-        return {
-            static_cast<int>(std::floor(x / hash_grid_cell_size)),
-            static_cast<int>(std::floor(y / hash_grid_cell_size))
-        };
+    CollisionDetectionSystem::~CollisionDetectionSystem() {
+        // The query points into this system's broadphase and proxies
+        if (auto *spatial_query = registry->ctx().find<SpatialQuery>()) {
+            spatial_query->detach();
+        }
+
+        registry->on_construct<BoxCollider2D>().disconnect(this);
+        registry->on_update<BoxCollider2D>().disconnect(this);
+        registry->on_destroy<BoxCollider2D>().disconnect(this);
+        registry->on_update<Transform>().disconnect(this);
+        registry->on_construct<Sleeping>().disconnect(this);
+        registry->on_destroy<Sleeping>().disconnect(this);
+    }
+
+    // A static or sleeping collider was added or removed
+    void CollisionDetectionSystem::on_collider_changed(entt::registry &registry, const entt::entity entity) {
+        if (registry.get<BoxCollider2D>(entity).is_static) {
+            static_colliders_dirty = true;
+        } else if (registry.all_of<Sleeping>(entity)) {
+            sleeping_colliders_dirty = true;
+        }
     }
 
-    // Registers an entity into its corresponding spatial hash grid cell
-    void CollisionDetectionSystem::register_entity_in_grid(const entt::entity entity, const Vector2 &position) {
-        const auto cell = get_hash_grid_cell(position.x, position.y);
-        hash_grid_cells[cell].push_back(entity);
+    // A collider was edited through registry.patch/replace; is_static may have been toggled either way
+    void CollisionDetectionSystem::on_collider_updated(entt::registry &, entt::entity) {
+        static_colliders_dirty = true;
+        sleeping_colliders_dirty = true;
     }
 
-    // Collects all nearby entities within a 3x3 grid neighborhood
-    std::vector<entt::entity> &CollisionDetectionSystem::get_nearby_entities(const Vector2 &position) {
-        thread_local std::vector<entt::entity> nearby_entities;
-        nearby_entities.clear();
+    // A static or sleeping collider was moved through registry.patch/replace
+    void CollisionDetectionSystem::on_transform_changed(entt::registry &registry, const entt::entity entity) {
+        const auto *collider = registry.try_get<BoxCollider2D>(entity);
+        if (!collider) return;
 
-        const auto base_cell = get_hash_grid_cell(position.x, position.y);
-        const auto [first, second] = base_cell;
+        if (collider->is_static) {
+            static_colliders_dirty = true;
+        } else if (registry.all_of<Sleeping>(entity)) {
+            sleeping_colliders_dirty = true;
+        }
+    }
 
-        for (int dx = -1; dx <= 1; dx++) {
-            for (int dy = -1; dy <= 1; dy++) {
-                auto cell = std::make_pair(first + dx, second + dy);
-                if (auto it = hash_grid_cells.find(cell); it != hash_grid_cells.end()) {
-                    nearby_entities.insert(nearby_entities.end(), it->second.begin(), it->second.end());
-                }
+    // A body fell asleep or woke up, moving it between the sleeping and the awake proxies. The
+    // static proxies are not affected.
+    void CollisionDetectionSystem::on_sleep_changed(entt::registry &, entt::entity) {
+        sleeping_colliders_dirty = true;
+    }
+
+    // Recreates the broadphase when the settings in the registry context changed. A new cell size
+    // alone is handed to the current backend, which rebins on its next update.
+    void CollisionDetectionSystem::sync_broadphase_settings() {
+        const auto &settings = registry->ctx().get<BroadphaseSettings>();
+        if (broadphase && settings.type == broadphase_settings.type) {
+            if (settings.cell_size != broadphase_settings.cell_size) {
+                broadphase->set_cell_size(settings.cell_size);
             }
+            broadphase_settings = settings;
+            return;
         }
 
-        return nearby_entities;
+        broadphase_settings = settings;
+        broadphase = make_broadphase(broadphase_settings);
+        static_colliders_dirty = true;
+
+        // The old backend is gone; queries resume after the next update
+        registry->ctx().get<SpatialQuery>().detach();
     }
 
+    // Gathers the collider bounds. Static proxies are only re-gathered when the static set changed,
+    // awake dynamic proxies are refreshed every frame. Sleeping bodies do not move either, so they
+    // get a passive range of their own right after the static one: awake bodies still collide with
+    // them, but they are never tested against each other or against static colliders, and a body
+    // falling asleep or waking up only re-gathers that range. Colliders with an empty layer or mask
+    // can never pass the layer filter and are left out of the broadphase entirely.
+    void CollisionDetectionSystem::populate_proxies() {
+        if (static_colliders_dirty) {
+            proxies.clear();
+            for (auto [entity_id, box_collider, transform]: registry->view<BoxCollider2D, Transform>().each()) {
+                if (box_collider.is_static && is_collidable(box_collider)) {
+                    proxies.push_back(entity_id, transform, box_collider);
+                }
+            }
+            proxies.static_count = proxies.size();
+        }
+
+        if (static_colliders_dirty || sleeping_colliders_dirty) {
+            proxies.resize(proxies.static_count);
+            for (auto [entity_id, box_collider, transform]: registry->view<Sleeping, BoxCollider2D, Transform>().each()) {
+                if (!box_collider.is_static && is_collidable(box_collider)) {
+                    proxies.push_back(entity_id, transform, box_collider);
+                }
+            }
+            proxies.passive_count = proxies.size();
+        } else {
+            proxies.resize(proxies.passive_count);
+        }
 
-    // Populates the hash grid with entities and resets their collision state
-    void CollisionDetectionSystem::populate_hash_grid_cells() {
-        const auto entity_view = registry->view<BoxCollider2D, Transform>();
+        // Looked up without creating the storage when no collider uses continuous collision
+        const auto *continuous_storage = std::as_const(*registry).storage<ContinuousCollision>();
+        continuous_proxies.clear();
 
-        for (auto [entity_id, box_collider, transform]: entity_view.each()) {
-            register_entity_in_grid(entity_id, transform.position);
-            box_collider.is_colliding = false; // Reset collision state
-            box_collider.colliding_entities.clear();
+        for (auto [entity_id, box_collider, transform]: registry->view<BoxCollider2D, Transform>(entt::exclude<Sleeping>).each()) {
+            if (!box_collider.is_static && is_collidable(box_collider)) {
+                if (continuous_storage && continuous_storage->contains(entity_id)) {
+                    continuous_proxies.push_back(proxies.size());
+                }
+                proxies.push_back(entity_id, transform, box_collider);
+            }
         }
     }
 
-    // Checks collisions between a set of entities and stores results in local_collision_result
-    void CollisionDetectionSystem::check_collision(
-        const std::vector<entt::entity> &entities,
-        CollisionResult &local_collision_result
+    // Clears the collision flag of the entities that collided last frame. Colliders that were not
+    // in any pair are already clear, so static colliders are not touched every frame.
+    void CollisionDetectionSystem::reset_collision_state() {
+        for (const auto &[entity_a_id, entity_b_id]: registry->ctx().get<ContactStream>().get_pairs()) {
+            for (const auto entity_id: {entity_a_id, entity_b_id}) {
+                if (!registry->valid(entity_id)) continue;
+                if (auto *box_collider = registry->try_get<BoxCollider2D>(entity_id)) {
+                    box_collider->is_colliding = false;
+                }
+            }
+        }
+    }
+
+    void CollisionDetectionSystem::update_broadphase() {
+        broadphase->update(proxies, static_colliders_dirty, static_colliders_dirty || sleeping_colliders_dirty);
+        static_colliders_dirty = false;
+        sleeping_colliders_dirty = false;
+
+        registry->ctx().get<SpatialQuery>().attach(broadphase.get(), &proxies);
+    }
+
+    // Finds the first impact of a proxy's box moving from `start` to `end` (centers) against the
+    // current bounds of the other proxies, treating them as stationary. Each candidate is grown by
+    // the half size of the box (Minkowski sum) and the motion is cast as a ray against it. Colliders
+    // that already overlap at `start` are left to the overlap solver.
+    bool CollisionDetectionSystem::sweep_proxy(
+        const std::uint32_t proxy,
+        const BoxCollider2D &collider,
+        const Vector2 start,
+        const Vector2 end,
+        float &fraction,
+        Vector2 &normal
     ) {
-        for (auto entity_a_id: entities) {
-            auto &transform_a = registry->get<Transform>(entity_a_id);
-            const auto &collider_a = registry->get<BoxCollider2D>(entity_a_id);
+        const float half_width = collider.width / 2;
+        const float half_height = collider.height / 2;
+        const Vector2 delta{end.x - start.x, end.y - start.y};
+
+        const Rectangle swept{
+            std::min(start.x, end.x) - half_width,
+            std::min(start.y, end.y) - half_height,
+            std::abs(delta.x) + collider.width,
+            std::abs(delta.y) + collider.height
+        };
 
-            std::vector<entt::entity> &nearby_entities = get_nearby_entities(transform_a.position);
+        sweep_candidates.clear();
+        broadphase->query_region(proxies, swept, collider.mask, sweep_candidates);
 
-            for (auto entity_b_id: nearby_entities) {
-                if (entity_a_id == entity_b_id) continue; // Skip self-collision
+        bool hit = false;
+        fraction = 1.0f;
 
-                // Sort entity pair to ensure consistent order (min, max)
-                auto entity_pair = std::minmax(entity_a_id, entity_b_id);
+        for (const auto other: sweep_candidates) {
+            if (other == proxy || !proxies.can_collide(proxy, other)) continue;
 
-                // Avoid duplicate collision checks
-                if (local_collision_result.pairs.contains(entity_pair)) continue;
+            const auto &other_collider = registry->get<BoxCollider2D>(proxies.entities[other]);
+            if (collider.is_trigger || other_collider.is_trigger || !collider.is_solid_with(other_collider)) continue;
 
-                const auto &transform_b = registry->get<Transform>(entity_b_id);
-                const auto &collider_b = registry->get<BoxCollider2D>(entity_b_id);
+            // Latest slab entry and earliest slab exit; a motion parallel to an axis has to be inside its slab
+            float entry = -std::numeric_limits<float>::infinity();
+            float exit = 1.0f;
+            Vector2 entry_normal{0.0f, 0.0f};
+            bool separated = false;
 
-                // Axis-Aligned Bounding Box (AABB) collision detection
-                const float a_min_x = transform_a.position.x - (collider_a.width / 2);
-                const float a_min_y = transform_a.position.y - (collider_a.height / 2);
-                const float b_min_x = transform_b.position.x - (collider_b.width / 2);
-                const float b_min_y = transform_b.position.y - (collider_b.height / 2);
+            const auto clip = [&](const float origin, const float motion, const float low, const float high, const Vector2 axis) {
+                if (motion == 0.0f) {
+                    separated |= origin <= low || origin >= high;
+                    return;
+                }
 
-                const bool is_colliding =
-                        a_min_x < b_min_x + collider_b.width &&
-                        a_min_x + collider_a.width > b_min_x &&
-                        a_min_y < b_min_y + collider_b.height &&
-                        a_min_y + collider_a.height > b_min_y;
+                float slab_entry = (low - origin) / motion;
+                float slab_exit = (high - origin) / motion;
+                if (slab_entry > slab_exit) std::swap(slab_entry, slab_exit);
 
-                if (is_colliding) {
-                    local_collision_result.pairs.insert(entity_pair);
+                if (slab_entry > entry) {
+                    entry = slab_entry;
+                    entry_normal = {motion > 0.0f ? -axis.x : axis.x, motion > 0.0f ? -axis.y : axis.y};
                 }
+                exit = std::min(exit, slab_exit);
+            };
+
+            clip(start.x, delta.x, proxies.min_x[other] - half_width, proxies.max_x[other] + half_width, {1.0f, 0.0f});
+            clip(start.y, delta.y, proxies.min_y[other] - half_height, proxies.max_y[other] + half_height, {0.0f, 1.0f});
+
+            // Already overlapping at the start (entry < 0), missed, or out of reach this frame
+            if (separated || entry < 0.0f || entry >= exit || entry >= fraction) continue;
+
+            fraction = entry;
+            normal = entry_normal;
+            hit = true;
+        }
+
+        return hit;
+    }
+
+    // Clamps the motion of the ContinuousCollision colliders at their first impact, then slides what
+    // is left of it along the surface. Proxies of clamped colliders are moved and the broadphase
+    // is brought up to date again before the pair search.
+    void CollisionDetectionSystem::resolve_continuous_motion() {
+        bool moved = false;
+
+        for (const auto proxy: continuous_proxies) {
+            const entt::entity entity = proxies.entities[proxy];
+            const auto *movement_data = registry->try_get<MovementData>(entity);
+            if (!movement_data) continue;
+
+            auto &transform = registry->get<Transform>(entity);
+            const auto &collider = registry->get<BoxCollider2D>(entity);
+
+            Vector2 start = movement_data->previous_position;
+            Vector2 end = transform.position;
+
+            for (int iteration = 0; iteration < CONTINUOUS_ITERATIONS; ++iteration) {
+                const Vector2 delta{end.x - start.x, end.y - start.y};
+                const float length = std::sqrt(delta.x * delta.x + delta.y * delta.y);
+                if (length <= CONTINUOUS_SKIN) break;
+
+                float fraction;
+                Vector2 normal;
+                if (!sweep_proxy(proxy, collider, start, end, fraction, normal)) break;
+
+                // Stop just short of the surface
+                const float clamped = std::max(0.0f, fraction - CONTINUOUS_SKIN / length);
+                const Vector2 contact{start.x + delta.x * clamped, start.y + delta.y * clamped};
+
+                // Slide: keep the part of the remaining motion that is tangent to the surface
+                Vector2 remaining{delta.x * (1.0f - clamped), delta.y * (1.0f - clamped)};
+                if (normal.x != 0.0f) remaining.x = 0.0f;
+                if (normal.y != 0.0f) remaining.y = 0.0f;
+
+                start = contact;
+                end = iteration + 1 < CONTINUOUS_ITERATIONS
+                          ? Vector2{contact.x + remaining.x, contact.y + remaining.y}
+                          : contact;
             }
+
+            if (end.x != transform.position.x || end.y != transform.position.y) {
+                transform.position = end;
+                proxies.set_bounds(proxy, transform, collider);
+                moved = true;
+            }
+        }
+
+        if (moved) {
+            broadphase->update(proxies, false, false);
+        }
+    }
+
+    // Runs the selected broadphase and turns its proxy pairs into entity pairs,
+    // sorted to keep the pair order deterministic.
+    void CollisionDetectionSystem::find_collision_pairs() {
+        proxy_pairs.clear();
+        broadphase->find_pairs(proxies, proxy_pairs);
+
+        collision_pairs.clear();
+        for (const auto &[proxy_a, proxy_b]: proxy_pairs) {
+            // Sort entity pair to ensure consistent order (min, max)
+            collision_pairs.push_back(std::minmax(proxies.entities[proxy_a], proxies.entities[proxy_b]));
+        }
+        std::sort(collision_pairs.begin(), collision_pairs.end());
+    }
+
+    // Fills the stats of this run: collider counts and sizes from the proxies, the rest from the backend
+    void CollisionDetectionSystem::collect_stats(BroadphaseStats &stats) const {
+        const std::uint32_t cell_size_changes = stats.cell_size_changes;
+        stats = {};
+        stats.cell_size_changes = cell_size_changes;
+
+        stats.collider_count = proxies.size();
+        stats.static_count = proxies.static_count;
+        stats.sleeping_count = proxies.passive_count - proxies.static_count;
+        stats.pairs_found = static_cast<std::uint32_t>(proxy_pairs.size());
+
+        float extent_sum = 0.0f;
+        for (std::uint32_t proxy = 0; proxy < proxies.size(); ++proxy) {
+            const float extent = std::max(proxies.max_x[proxy] - proxies.min_x[proxy],
+                                          proxies.max_y[proxy] - proxies.min_y[proxy]);
+            extent_sum += extent;
+            stats.max_extent = std::max(stats.max_extent, extent);
+
+            // Bucket 0 holds extents below 1, bucket i those in [2^(i-1), 2^i)
+            int exponent = 0;
+            std::frexp(extent, &exponent);
+            const auto bucket = static_cast<std::size_t>(std::clamp(exponent, 0, static_cast<int>(BroadphaseStats::SIZE_BUCKETS) - 1));
+            ++stats.size_histogram[bucket];
+        }
+        stats.mean_extent = proxies.size() > 0 ? extent_sum / static_cast<float>(proxies.size()) : 0.0f;
+
+        broadphase->collect_stats(stats);
+    }
+
+    // Picks the grid cell size from the collider size histogram: a cell about twice the size of
+    // most colliders keeps nearly all of them binned while keeping the cells small. The histogram
+    // is coarse, so a new size is only applied once it has been wanted for a while.
+    void CollisionDetectionSystem::tune_cell_size(BroadphaseStats &stats) {
+        auto &settings = registry->ctx().get<BroadphaseSettings>();
+        if (!settings.auto_cell_size || settings.type != BroadphaseType::HashGrid || stats.collider_count == 0) {
+            tuning_frames = 0;
+            return;
+        }
+
+        // Upper bound of the bucket holding the percentile
+        const auto wanted = static_cast<std::uint32_t>(
+            std::ceil(static_cast<float>(stats.collider_count) * AUTO_CELL_SIZE_PERCENTILE));
+        std::uint32_t seen = 0;
+        std::size_t bucket = 0;
+        while (bucket + 1 < BroadphaseStats::SIZE_BUCKETS && (seen += stats.size_histogram[bucket]) < wanted) {
+            ++bucket;
+        }
+
+        const float target = std::clamp(AUTO_CELL_SIZE_FACTOR * std::ldexp(1.0f, static_cast<int>(bucket)),
+                                        MIN_AUTO_CELL_SIZE, MAX_AUTO_CELL_SIZE);
+
+        if (std::abs(target - settings.cell_size) <= settings.cell_size * CELL_SIZE_TUNE_THRESHOLD) {
+            tuning_frames = 0;
+            return;
+        }
+
+        if (target != tuning_target) {
+            tuning_target = target;
+            tuning_frames = 0;
+        }
+
+        if (++tuning_frames >= CELL_SIZE_TUNE_FRAMES) {
+            // Applied by sync_broadphase_settings() on the next run
+            settings.cell_size = target;
+            ++stats.cell_size_changes;
+            tuning_frames = 0;
         }
     }
 
@@ -117,86 +388,34 @@ namespace rpg {
 
     // Main update loop
     void CollisionDetectionSystem::run(float dt) {
-        hash_grid_cells.clear();
-        populate_hash_grid_cells();
-
-        // Extract all occupied grid cells
-        std::vector<std::pair<int, int> > all_cells;
-        all_cells.reserve(hash_grid_cells.size());
-        for (const auto &key: hash_grid_cells | std::views::keys) {
-            all_cells.push_back(key);
-        }
-
-        // Perform parallel collision checks using transform_reduce
-        CollisionResult merged_result = std::transform_reduce(
-            std::execution::par,
-            all_cells.begin(),
-            all_cells.end(),
-            CollisionResult{},
-
-            // Merge local results into one
-            [](CollisionResult a, const CollisionResult &b) {
-                a.pairs.insert(b.pairs.begin(), b.pairs.end());
-                return a;
-            },
-
-            // Check collisions in each cell
-            [&](const auto &cell_coord) {
-                CollisionResult local;
-
-                if (auto it = hash_grid_cells.find(cell_coord); it != hash_grid_cells.end()) {
-                    const auto &entities_in_cell = it->second;
-                    check_collision(entities_in_cell, local);
-                }
-                return local;
-            }
-        );
-
-        // Mark entities as colliding and store references
-        std::unordered_set<std::pair<entt::entity, entt::entity>, EntityPairHash, EntityPairEqual> processed_pairs;
-        for (auto &pair: merged_result.pairs) {
-            if (!processed_pairs.contains(pair)) {
-                processed_pairs.insert(pair);
+        sync_broadphase_settings();
+        reset_collision_state();
+        populate_proxies();
+        update_broadphase();
+        resolve_continuous_motion();
+        find_collision_pairs();
 
-                auto entity_a_id = pair.first;
-                auto entity_b_id = pair.second;
+        // Mark entities as colliding
+        for (const auto &[entity_a_id, entity_b_id]: collision_pairs) {
+            auto &collider_a = registry->get<BoxCollider2D>(entity_a_id);
+            auto &collider_b = registry->get<BoxCollider2D>(entity_b_id);
 
-                auto &collider_a = registry->get<BoxCollider2D>(entity_a_id);
-                auto &collider_b = registry->get<BoxCollider2D>(entity_b_id);
-
-                collider_a.is_colliding = true;
-                collider_b.is_colliding = true;
-                collider_a.colliding_entities.insert(entity_b_id);
-                collider_b.colliding_entities.insert(entity_a_id);
+            collider_a.is_colliding = true;
+            collider_b.is_colliding = true;
 
 #if BUILD_DRAW_DEBUG_COLLIDER_SHAPE_MODE
-                auto transform_a = registry->get<Transform>(entity_a_id);
-                auto transform_b = registry->get<Transform>(entity_b_id);
+            auto transform_a = registry->get<Transform>(entity_a_id);
+            auto transform_b = registry->get<Transform>(entity_b_id);
 
-                draw_debug_collider_shape(collider_a, transform_a);
-                draw_debug_collider_shape(collider_b, transform_b);
+            draw_debug_collider_shape(collider_a, transform_a);
+            draw_debug_collider_shape(collider_b, transform_b);
 #endif
-            }
         }
-    }
-
-    std::size_t CollisionDetectionSystem::EntityPairHash::operator()(
-        const std::pair<entt::entity, entt::entity> &pair) const {
-        // Normalize entity order so hash is symmetric
-        const entt::entity min_entity = std::min(pair.first, pair.second);
-        const entt::entity max_entity = std::max(pair.first, pair.second);
 
-        const size_t hash_min = std::hash<entt::entity>()(min_entity);
-        const size_t hash_max = std::hash<entt::entity>()(max_entity);
-
-        // Combine hashes using a variant of boost::hash_combine
-        return hash_min ^ (hash_max + 0x9e3779b9 + (hash_min << 6) + (hash_min >> 2));
-    }
+        registry->ctx().get<ContactStream>().publish(collision_pairs);
 
-    bool CollisionDetectionSystem::EntityPairEqual::operator()(const std::pair<entt::entity, entt::entity> &lhs,
-                                                               const std::pair<entt::entity, entt::entity> &rhs) const {
-        // Equal if both entities match, regardless of order
-        return (lhs.first == rhs.first && lhs.second == rhs.second) ||
-               (lhs.first == rhs.second && lhs.second == rhs.first);
+        auto &stats = registry->ctx().get<BroadphaseStats>();
+        collect_stats(stats);
+        tune_cell_size(stats);
     }
 } // namespace rpg
@@ -3,60 +3,109 @@
 
 #include "system.h"
 #include <raylib.h>
-#include <unordered_map>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <entt/entt.hpp>
 
+#include "engine/collision/broadphase.h"
+#include "engine/collision/collider_proxies.h"
+#include "engine/collision/contact_stream.h"
+#include "engine/collision/spatial_query.h"
 #include "engine/components/components.h"
 
 namespace rpg {
 
     class CollisionDetectionSystem final : public System {
-        struct PairHash {
-            std::size_t operator()(const std::pair<int, int> &p) const {
-                return std::hash<int>()(p.first) ^ (std::hash<int>()(p.second) << 1);
-            }
-        };
+        BroadphaseSettings broadphase_settings;
+        std::unique_ptr<Broadphase> broadphase;
 
-        struct EntityPairHash {
-            std::size_t operator()(const std::pair<entt::entity, entt::entity> &pair) const;
-        };
+        // Static colliders occupy the first proxies and sleeping bodies the next ones; each range is
+        // only re-gathered when its own set changes, and the sleeping one also when the static one does
+        ColliderProxies proxies;
+        bool static_colliders_dirty = true;
+        bool sleeping_colliders_dirty = true;
 
-        // Equality check for entity pairs, order-independent.
-        struct EntityPairEqual {
-            bool operator()(
-                const std::pair<entt::entity, entt::entity> &lhs,
-                const std::pair<entt::entity, entt::entity> &rhs
-            ) const;
-        };
+        // Dynamic proxies of the colliders tagged with ContinuousCollision
+        std::vector<std::uint32_t> continuous_proxies;
+        std::vector<std::uint32_t> sweep_candidates;
 
-        // Local results for each thread
-        struct CollisionResult {
-            std::unordered_set<std::pair<entt::entity, entt::entity>, EntityPairHash, EntityPairEqual> pairs;
-        };
+        std::vector<ProxyPair> proxy_pairs;
 
-        float hash_grid_cell_size{250.0f};
-        std::unordered_map<std::pair<int, int>, std::vector<entt::entity>, PairHash> hash_grid_cells;
+        // Cell size the automatic tuning is heading for, and for how many frames in a row it was wanted
+        float tuning_target = 0.0f;
+        int tuning_frames = 0;
+        // Pairs of this frame until they are published to the ContactStream
+        std::vector<EntityPair> collision_pairs;
 
-        std::pair<int, int> get_hash_grid_cell(float x, float y) const;
+        void sync_broadphase_settings();
 
-        void register_entity_in_grid(entt::entity entity, const Vector2 &position);
+        void populate_proxies();
 
-        std::vector<entt::entity> &get_nearby_entities(const Vector2 &position);
+        static bool is_collidable(const BoxCollider2D &collider) { return collider.layer != 0 && collider.mask != 0; }
 
-        void populate_hash_grid_cells();
+        void reset_collision_state();
 
-        void check_collision(const std::vector<entt::entity> &entities, CollisionResult &local_collision_result);
+        void update_broadphase();
+
+        void resolve_continuous_motion();
+
+        bool sweep_proxy(std::uint32_t proxy, const BoxCollider2D &collider, Vector2 start, Vector2 end,
+                         float &fraction, Vector2 &normal);
+
+        void find_collision_pairs();
+
+        void collect_stats(BroadphaseStats &stats) const;
+
+        void tune_cell_size(BroadphaseStats &stats);
+
+        void on_collider_changed(entt::registry &registry, entt::entity entity);
+
+        void on_collider_updated(entt::registry &registry, entt::entity entity);
+
+        void on_transform_changed(entt::registry &registry, entt::entity entity);
+
+        void on_sleep_changed(entt::registry &registry, entt::entity entity);
 
 #if BUILD_DRAW_DEBUG_COLLIDER_SHAPE_MODE
         static void draw_debug_collider_shape(BoxCollider2D& collision, rpg::Transform& transform);
 #endif
 
     public:
-        explicit CollisionDetectionSystem(entt::registry *registry);
+        // The broadphase strategy is stored in the registry context as BroadphaseSettings;
+        // changing it there (e.g. from a scene) switches the backend on the next run.
+        // Contacts are published every run to the ContactStream in the registry context, and the
+        // SpatialQuery in the context answers queries against the broadphase of the last run.
+        // BroadphaseStats in the context describe the last run; with auto_cell_size set, the grid
+        // cell size is re-picked from the collider sizes they record.
+        explicit CollisionDetectionSystem(entt::registry *registry,
+                                          BroadphaseType broadphase_type = BroadphaseType::HashGrid);
+
+        ~CollisionDetectionSystem() override;
 
         void run(float dt) override;
+
+        // Forces the static colliders to be re-gathered, e.g. after moving one
+        // without going through registry.patch/replace.
+        void mark_static_colliders_dirty() { static_colliders_dirty = true; }
+
+    private:
+        // Sweeps per continuous mover: the first clamps the motion, the others slide the rest of it
+        // along the surfaces that were hit (default: 3).
+        static constexpr int CONTINUOUS_ITERATIONS = 3;
+        // Distance kept from the surface a continuous mover was stopped at (default: 0.01f).
+        static constexpr float CONTINUOUS_SKIN = 0.01f;
+        // Automatic cell size, as a multiple of the collider extent below (default: 2.0f).
+        static constexpr float AUTO_CELL_SIZE_FACTOR = 2.0f;
+        // Share of the colliders whose extent the automatic cell size is based on (default: 0.9f).
+        static constexpr float AUTO_CELL_SIZE_PERCENTILE = 0.9f;
+        // Bounds of the automatic cell size (default: 16.0f and 2048.0f).
+        static constexpr float MIN_AUTO_CELL_SIZE = 16.0f;
+        static constexpr float MAX_AUTO_CELL_SIZE = 2048.0f;
+        // A new cell size has to differ from the current one by more than this fraction, for
+        // CELL_SIZE_TUNE_FRAMES frames in a row, before it is applied (default: 0.25f and 30).
+        static constexpr float CELL_SIZE_TUNE_THRESHOLD = 0.25f;
+        static constexpr int CELL_SIZE_TUNE_FRAMES = 30;
     };
 } // namespace rpg
 
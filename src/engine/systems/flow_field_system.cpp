@@ -0,0 +1,282 @@
+// flow_field_system.cpp
+// Purpose: Cost grid, Dijkstra integration and direction field of FlowFieldSystem.
+
+#include "flow_field_system.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "raymath.h"
+#include "sleep_system.h"
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    namespace {
+        struct Neighbor {
+            std::int32_t dx;
+            std::int32_t dy;
+            float cost;
+            // Unit direction toward the neighbor
+            Vector2 direction;
+        };
+
+        constexpr float DIAGONAL_COST = 1.41421356f;
+        constexpr float DIAGONAL_AXIS = 0.70710678f;
+
+        // Orthogonal neighbors first, so a tie between distances goes to the straight step
+        constexpr std::array<Neighbor, 8> NEIGHBORS{{
+            {1, 0, 1.0f, {1.0f, 0.0f}},
+            {-1, 0, 1.0f, {-1.0f, 0.0f}},
+            {0, 1, 1.0f, {0.0f, 1.0f}},
+            {0, -1, 1.0f, {0.0f, -1.0f}},
+            {1, 1, DIAGONAL_COST, {DIAGONAL_AXIS, DIAGONAL_AXIS}},
+            {1, -1, DIAGONAL_COST, {DIAGONAL_AXIS, -DIAGONAL_AXIS}},
+            {-1, 1, DIAGONAL_COST, {-DIAGONAL_AXIS, DIAGONAL_AXIS}},
+            {-1, -1, DIAGONAL_COST, {-DIAGONAL_AXIS, -DIAGONAL_AXIS}},
+        }};
+
+        constexpr float UNREACHABLE = std::numeric_limits<float>::infinity();
+
+        // Only solid, static colliders block the agents; triggers and filtered-out colliders do not
+        bool is_obstacle(const BoxCollider2D &collider) {
+            return collider.is_static && !collider.is_trigger && collider.layer != 0 && collider.mask != 0;
+        }
+    }
+
+    FlowFieldSystem::FlowFieldSystem(entt::registry *registry): System(registry) {
+        registry->on_construct<BoxCollider2D>().connect<&FlowFieldSystem::on_collider_changed>(this);
+        registry->on_update<BoxCollider2D>().connect<&FlowFieldSystem::on_collider_updated>(this);
+        registry->on_destroy<BoxCollider2D>().connect<&FlowFieldSystem::on_collider_changed>(this);
+        registry->on_update<Transform>().connect<&FlowFieldSystem::on_transform_changed>(this);
+    }
+
+    FlowFieldSystem::~FlowFieldSystem() {
+        registry->on_construct<BoxCollider2D>().disconnect(this);
+        registry->on_update<BoxCollider2D>().disconnect(this);
+        registry->on_destroy<BoxCollider2D>().disconnect(this);
+        registry->on_update<Transform>().disconnect(this);
+    }
+
+    // A static collider was added or removed
+    void FlowFieldSystem::on_collider_changed(entt::registry &registry, const entt::entity entity) {
+        if (registry.get<BoxCollider2D>(entity).is_static) {
+            costs_dirty = true;
+        }
+    }
+
+    // A collider was edited through registry.patch/replace; is_static may have been toggled either way
+    void FlowFieldSystem::on_collider_updated(entt::registry &, entt::entity) {
+        costs_dirty = true;
+    }
+
+    // A static collider was moved through registry.patch/replace
+    void FlowFieldSystem::on_transform_changed(entt::registry &registry, const entt::entity entity) {
+        if (const auto *collider = registry.try_get<BoxCollider2D>(entity); collider && collider->is_static) {
+            costs_dirty = true;
+        }
+    }
+
+    // Resizes the grid to the WorldBounds in the registry context; returns false while there are none
+    bool FlowFieldSystem::sync_bounds() {
+        const auto *world_bounds = registry->ctx().find<WorldBounds>();
+        if (!world_bounds) return false;
+
+        const Rectangle &area = world_bounds->area;
+        if (area.x != bounds.x || area.y != bounds.y || area.width != bounds.width || area.height != bounds.height) {
+            bounds = area;
+            columns = std::max(0, static_cast<std::int32_t>(std::ceil(area.width / CELL_SIZE)));
+            rows = std::max(0, static_cast<std::int32_t>(std::ceil(area.height / CELL_SIZE)));
+
+            const auto cell_count = static_cast<std::size_t>(columns) * static_cast<std::size_t>(rows);
+            blocked_cells.assign(cell_count, 0);
+            distances.assign(cell_count, UNREACHABLE);
+            directions.assign(cell_count, {0.0f, 0.0f});
+            changed_cells.assign(cell_count, 0);
+
+            target_cell = NO_CELL;
+            costs_dirty = true;
+        }
+
+        return columns > 0 && rows > 0;
+    }
+
+    // Blocks every cell a static collider overlaps. Touching a cell's border does not count, the
+    // same strict overlap rule the collision detection uses.
+    void FlowFieldSystem::rasterize_costs() {
+        std::fill(blocked_cells.begin(), blocked_cells.end(), 0);
+
+        for (auto [entity, box_collider, transform]: registry->view<BoxCollider2D, Transform>().each()) {
+            if (!is_obstacle(box_collider)) continue;
+
+            const float left = transform.position.x - (box_collider.width / 2) - bounds.x;
+            const float top = transform.position.y - (box_collider.height / 2) - bounds.y;
+            const float right = left + box_collider.width;
+            const float bottom = top + box_collider.height;
+
+            const auto first_column = std::max(0, static_cast<std::int32_t>(std::floor(left / CELL_SIZE)));
+            const auto first_row = std::max(0, static_cast<std::int32_t>(std::floor(top / CELL_SIZE)));
+            const auto last_column = std::min(columns - 1, static_cast<std::int32_t>(std::ceil(right / CELL_SIZE)) - 1);
+            const auto last_row = std::min(rows - 1, static_cast<std::int32_t>(std::ceil(bottom / CELL_SIZE)) - 1);
+
+            for (std::int32_t row = first_row; row <= last_row; ++row) {
+                for (std::int32_t column = first_column; column <= last_column; ++column) {
+                    blocked_cells[row * columns + column] = 1;
+                }
+            }
+        }
+    }
+
+    // A step into a blocked cell, or diagonally past one, is not allowed, so agents do not cut corners
+    bool FlowFieldSystem::can_step(const std::int32_t column, const std::int32_t row,
+                                   const std::int32_t dx, const std::int32_t dy) const {
+        const std::int32_t next_column = column + dx;
+        const std::int32_t next_row = row + dy;
+        if (next_column < 0 || next_column >= columns || next_row < 0 || next_row >= rows) return false;
+        if (blocked_cells[next_row * columns + next_column]) return false;
+
+        if (dx != 0 && dy != 0) {
+            return !blocked_cells[row * columns + next_column] && !blocked_cells[next_row * columns + column];
+        }
+        return true;
+    }
+
+    // Dijkstra over the free cells, starting at the target cell. Entries are not removed from the
+    // heap when a cell gets a shorter distance; the stale ones are skipped when popped.
+    void FlowFieldSystem::integrate_distances() {
+        std::fill(distances.begin(), distances.end(), UNREACHABLE);
+        if (target_cell == NO_CELL) return;
+
+        constexpr auto closer = [](const std::pair<float, std::uint32_t> &a, const std::pair<float, std::uint32_t> &b) {
+            return a.first > b.first;
+        };
+
+        open_cells.clear();
+        distances[target_cell] = 0.0f;
+        open_cells.emplace_back(0.0f, target_cell);
+
+        while (!open_cells.empty()) {
+            std::pop_heap(open_cells.begin(), open_cells.end(), closer);
+            const auto [distance, cell] = open_cells.back();
+            open_cells.pop_back();
+            if (distance > distances[cell]) continue;
+
+            const auto column = static_cast<std::int32_t>(cell % columns);
+            const auto row = static_cast<std::int32_t>(cell / columns);
+
+            for (const auto &neighbor: NEIGHBORS) {
+                if (!can_step(column, row, neighbor.dx, neighbor.dy)) continue;
+
+                const auto next = static_cast<std::uint32_t>((row + neighbor.dy) * columns + column + neighbor.dx);
+                const float next_distance = distance + neighbor.cost;
+                if (next_distance < distances[next]) {
+                    distances[next] = next_distance;
+                    open_cells.emplace_back(next_distance, next);
+                    std::push_heap(open_cells.begin(), open_cells.end(), closer);
+                }
+            }
+        }
+    }
+
+    // Points every cell at its reachable neighbor closest to the target. Blocked cells point out of
+    // the obstacle too, for agents that were pushed into one. Records which cells got a new direction.
+    void FlowFieldSystem::build_directions() {
+        for (std::int32_t row = 0; row < rows; ++row) {
+            for (std::int32_t column = 0; column < columns; ++column) {
+                const std::int32_t cell = row * columns + column;
+                const bool is_blocked = blocked_cells[cell] != 0;
+
+                float best_distance = is_blocked ? UNREACHABLE : distances[cell];
+                Vector2 best_direction{0.0f, 0.0f};
+
+                for (const auto &neighbor: NEIGHBORS) {
+                    const std::int32_t next_column = column + neighbor.dx;
+                    const std::int32_t next_row = row + neighbor.dy;
+                    if (next_column < 0 || next_column >= columns || next_row < 0 || next_row >= rows) continue;
+                    if (!is_blocked && !can_step(column, row, neighbor.dx, neighbor.dy)) continue;
+
+                    if (const float distance = distances[next_row * columns + next_column]; distance < best_distance) {
+                        best_distance = distance;
+                        best_direction = neighbor.direction;
+                    }
+                }
+
+                const Vector2 previous = directions[cell];
+                changed_cells[cell] = previous.x != best_direction.x || previous.y != best_direction.y;
+                directions[cell] = best_direction;
+            }
+        }
+    }
+
+    // Agents asleep in a cell whose direction changed would never notice, since nothing moves them.
+    // The others would be steered the same way they were when they fell asleep, so they keep sleeping.
+    void FlowFieldSystem::wake_agents() {
+        for (auto [entity, transform]: registry->view<FlowFieldAgent, Transform, Sleeping>().each()) {
+            if (const std::uint32_t cell = get_cell(transform.position); cell != NO_CELL && changed_cells[cell]) {
+                wake_body(*registry, entity);
+            }
+        }
+    }
+
+    void FlowFieldSystem::steer_agents(const Vector2 target) {
+        const auto view = registry->view<FlowFieldAgent, Transform, MovementData>(entt::exclude<Sleeping>);
+
+        for (auto [entity, transform, movement_data]: view.each()) {
+            const std::uint32_t cell = get_cell(transform.position);
+
+            // The field stops at the target's cell; from there agents head straight for it
+            const Vector2 direction = cell != NO_CELL && cell == target_cell
+                                          ? Vector2Normalize(Vector2Subtract(target, transform.position))
+                                          : sample(transform.position);
+
+            movement_data.velocity = Vector2Scale(direction, movement_data.speed);
+        }
+    }
+
+    std::uint32_t FlowFieldSystem::get_cell(const Vector2 position) const {
+        const float x = position.x - bounds.x;
+        const float y = position.y - bounds.y;
+        if (!(x >= 0.0f && x < bounds.width && y >= 0.0f && y < bounds.height)) return NO_CELL;
+
+        const auto column = std::min(columns - 1, static_cast<std::int32_t>(x / CELL_SIZE));
+        const auto row = std::min(rows - 1, static_cast<std::int32_t>(y / CELL_SIZE));
+        return static_cast<std::uint32_t>(row * columns + column);
+    }
+
+    Vector2 FlowFieldSystem::sample(const Vector2 position) const {
+        const std::uint32_t cell = get_cell(position);
+        return cell != NO_CELL ? directions[cell] : Vector2{0.0f, 0.0f};
+    }
+
+    // Follows the first entity with Input, like CameraSystem
+    void FlowFieldSystem::run(float dt) {
+        if (!sync_bounds()) return;
+
+        const auto view = registry->view<Input, Transform>();
+        if (view.begin() == view.end()) return;
+        const Vector2 target = view.get<Transform>(*view.begin()).position;
+
+        bool field_changed = false;
+        if (costs_dirty) {
+            rasterize_costs();
+            costs_dirty = false;
+            field_changed = true;
+        }
+
+        if (const std::uint32_t cell = get_cell(target); cell != target_cell) {
+            target_cell = cell;
+            field_changed = true;
+        }
+
+        if (field_changed) {
+            integrate_distances();
+            build_directions();
+            wake_agents();
+        }
+
+        steer_agents(target);
+    }
+
+} // namespace rpg
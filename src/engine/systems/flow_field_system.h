@@ -0,0 +1,85 @@
+// flow_field_system.h
+// Purpose: Steers crowds toward the player with one shared flow field instead of a path per agent.
+// Static colliders are rasterized into a grid of blocked cells covering the WorldBounds, a Dijkstra
+// pass from the player's cell gives every cell its distance to the player, and every cell points
+// to its closest neighbor. Agents then set their velocity from the cell they stand in, at constant
+// cost per agent. The distances and directions are only recomputed when the player enters another
+// cell or the static colliders change.
+
+#ifndef FLOW_FIELD_SYSTEM_H
+#define FLOW_FIELD_SYSTEM_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "system.h"
+#include "raylib.h"
+#include "entt/entt.hpp"
+
+namespace rpg {
+
+    // Runs before MoveSystem, so the agents move with this step's field.
+    class FlowFieldSystem final : public System {
+        // Area covered by the grid and its size in cells
+        Rectangle bounds{0.0f, 0.0f, 0.0f, 0.0f};
+        std::int32_t columns = 0;
+        std::int32_t rows = 0;
+
+        std::vector<std::uint8_t> blocked_cells;
+        // Path length from each cell to the target cell, infinite where it cannot be reached
+        std::vector<float> distances;
+        // Unit direction toward the neighbor closest to the target, zero where there is none
+        std::vector<Vector2> directions;
+        // Cells whose direction changed the last time the field was rebuilt
+        std::vector<std::uint8_t> changed_cells;
+
+        // Dijkstra frontier as a min-heap of (distance, cell)
+        std::vector<std::pair<float, std::uint32_t> > open_cells;
+
+        std::uint32_t target_cell = NO_CELL;
+        bool costs_dirty = true;
+
+        void on_collider_changed(entt::registry &registry, entt::entity entity);
+
+        void on_collider_updated(entt::registry &registry, entt::entity entity);
+
+        void on_transform_changed(entt::registry &registry, entt::entity entity);
+
+        bool sync_bounds();
+
+        void rasterize_costs();
+
+        void integrate_distances();
+
+        void build_directions();
+
+        void wake_agents();
+
+        void steer_agents(Vector2 target);
+
+        [[nodiscard]] bool can_step(std::int32_t column, std::int32_t row, std::int32_t dx, std::int32_t dy) const;
+
+        [[nodiscard]] std::uint32_t get_cell(Vector2 position) const;
+
+    public:
+        explicit FlowFieldSystem(entt::registry *registry);
+
+        ~FlowFieldSystem() override;
+
+        void run(float dt) override;
+
+        // Direction of the cell containing `position`; zero outside the grid and where the target
+        // cannot be reached
+        [[nodiscard]] Vector2 sample(Vector2 position) const;
+
+    private:
+        // Side of a grid cell in world units (default: 32.0f).
+        static constexpr float CELL_SIZE = 32.0f;
+        // Marks a position outside the grid.
+        static constexpr std::uint32_t NO_CELL = 0xFFFFFFFF;
+    };
+
+} // namespace rpg
+
+#endif // FLOW_FIELD_SYSTEM_H
@@ -3,27 +3,113 @@
 //
 
 #include "move_system.h"
+
+#include <algorithm>
+#include <execution>
+
 #include "engine/components/components.h"
 #include "raylib.h"
 #include "raymath.h"
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)
+#define RPG_INTEGRATION_SSE 1
+#include <immintrin.h>
+#endif
+
 namespace rpg {
+    namespace {
+        // Owns both storages so the awake bodies are packed at the front of each, in the same order
+        auto get_moving_group(entt::registry &registry) {
+            return registry.group<Transform, MovementData>(entt::get<>, entt::exclude<Sleeping>);
+        }
+
+        // Remembers where each body starts the step, for continuous collision and render
+        // interpolation, then moves it by its velocity. Computes exactly what
+        // Vector2Add(position, Vector2Scale(velocity, dt)) would.
+        void integrate_bodies(Transform *transforms, MovementData *movement_data, const std::uint32_t count, const float dt) {
+            std::uint32_t i = 0;
+
+#if RPG_INTEGRATION_SSE
+            // Positions and velocities are interleaved with other fields, so two bodies fill a register
+            const __m128 step = _mm_set1_ps(dt);
+            for (; i + 2 <= count; i += 2) {
+                auto *position_a = reinterpret_cast<__m64 *>(&transforms[i].position);
+                auto *position_b = reinterpret_cast<__m64 *>(&transforms[i + 1].position);
+                const auto *velocity_a = reinterpret_cast<const __m64 *>(&movement_data[i].velocity);
+                const auto *velocity_b = reinterpret_cast<const __m64 *>(&movement_data[i + 1].velocity);
+
+                const __m128 position = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), position_a), position_b);
+                const __m128 velocity = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), velocity_a), velocity_b);
+
+                _mm_storel_pi(reinterpret_cast<__m64 *>(&movement_data[i].previous_position), position);
+                _mm_storeh_pi(reinterpret_cast<__m64 *>(&movement_data[i + 1].previous_position), position);
+
+                const __m128 moved = _mm_add_ps(position, _mm_mul_ps(velocity, step));
+                _mm_storel_pi(position_a, moved);
+                _mm_storeh_pi(position_b, moved);
+            }
+#endif
+
+            for (; i < count; ++i) {
+                movement_data[i].previous_position = transforms[i].position;
+                transforms[i].position = Vector2Add(transforms[i].position, Vector2Scale(movement_data[i].velocity, dt));
+            }
+        }
+    }
+
     MoveSystem::MoveSystem(entt::registry *registry): System(registry) {
+        // Created up front so the storages are arranged before the first step
+        get_moving_group(*registry);
     }
 
     void MoveSystem::run(float dt) {
-        for (auto view = registry->view<Input, Transform, MovementData>(); const auto entity: view) {
-            auto &&[input, transform, movement_data] = view.get<Input, Transform, MovementData>(entity);
+        apply_input();
+        integrate(dt);
+    }
+
+    // Turns the input direction of the player-driven bodies into their velocity
+    void MoveSystem::apply_input() {
+        for (auto view = registry->view<Input, MovementData>(entt::exclude<Sleeping>); const auto entity: view) {
+            auto &&[input, movement_data] = view.get<Input, MovementData>(entity);
 
-            movement_data.previous_position = transform.position;
             input.move_direction = Vector2Normalize(input.move_direction);
 
             movement_data.velocity = {
                 input.move_direction.x  * movement_data.speed,
                 input.move_direction.y  * movement_data.speed
             };
+        }
+    }
+
+    // Advances the awake bodies page by page; the pages are independent, so large groups are split
+    // across threads
+    void MoveSystem::integrate(const float dt) {
+        const auto group = get_moving_group(*registry);
+        const auto count = static_cast<std::uint32_t>(group.size());
+        if (count == 0) return;
+
+        auto &transforms = *group.storage<Transform>();
+        auto &movement_data = *group.storage<MovementData>();
+
+        // Both storages use the same page size, so a body sits at the same page and offset in each
+        constexpr auto page_size = static_cast<std::uint32_t>(entt::component_traits<Transform>::page_size);
+        static_assert(entt::component_traits<MovementData>::page_size == page_size);
+
+        ranges.clear();
+        for (std::uint32_t begin = 0; begin < count; begin += page_size) {
+            ranges.push_back({begin, std::min(count, begin + page_size)});
+        }
+
+        const auto integrate_range = [&](const IntegrationRange &range) {
+            const std::uint32_t page = range.begin / page_size;
+            const std::uint32_t offset = range.begin % page_size;
+            integrate_bodies(transforms.raw()[page] + offset, movement_data.raw()[page] + offset, range.end - range.begin, dt);
+        };
 
-            transform.position = Vector2Add(transform.position, Vector2Scale(movement_data.velocity, dt));
+        if (count < PARALLEL_THRESHOLD) {
+            std::for_each(ranges.begin(), ranges.end(), integrate_range);
+        } else {
+            std::for_each(std::execution::par, ranges.begin(), ranges.end(), integrate_range);
         }
     }
 } // rpg
@@ -6,12 +6,34 @@
 #define MOVE_SYSTEM_H
 #include "system.h"
 
+#include <cstdint>
+#include <vector>
+
 namespace rpg {
 
+// Integrates every awake body with MovementData. Bodies driven by Input get their velocity from
+// the input direction first; all of them are then advanced over the packed storage of an owning
+// group, one storage page per task, with an SSE kernel moving two bodies at a time.
 class MoveSystem : public System{
 public:
     explicit MoveSystem(entt::registry* registry);
     void run(float dt) override;
+
+private:
+    // Bodies [begin, end) of the group, all within one storage page
+    struct IntegrationRange {
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    void apply_input();
+
+    void integrate(float dt);
+
+    std::vector<IntegrationRange> ranges;
+
+    // Bodies below which the integration runs on the calling thread (default: 4096).
+    static constexpr std::uint32_t PARALLEL_THRESHOLD = 4096;
 };
 
 } // rpg
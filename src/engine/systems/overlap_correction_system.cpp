@@ -1,186 +1,594 @@
 
 #include "overlap_correction_system.h"
+#include <algorithm>
+#include <cmath>
 #include <execution>
-#include <numeric>
+#include <limits>
 
 #include "raymath.h"
+#include "engine/collision/spatial_query.h"
 #include "engine/components/components.h"
+#include "engine/systems/sleep_system.h"
 
 namespace rpg {
 
 OverlapCorrectionSystem::OverlapCorrectionSystem(entt::registry* registry)
-    : System(registry) {}
+    : System(registry), displaced_grid(DISPLACED_CELL_SIZE) {}
 
 
-    // Main execution of the system, performs up to MAX_ITERATIONS to resolve all overlaps
+    // Main execution of the system, performs up to MAX_ITERATIONS per island to resolve all overlaps,
+    // and MAX_ITERATIONS more whenever redetection gives an island new pairs, within MAX_ROUNDS
     void OverlapCorrectionSystem::run(float delta_time) {
-    bool has_overlap = true;
-    int iteration = 0;
+    auto &stats = registry->ctx().contains<OverlapSolverStats>()
+                      ? registry->ctx().get<OverlapSolverStats>()
+                      : registry->ctx().emplace<OverlapSolverStats>();
 
-    while (has_overlap && iteration < MAX_ITERATIONS) {
-        // 1. Collect pairs of entities in collision
-        auto overlapping_pairs = collect_overlapping_pairs();
+    // 1. Collect pairs of entities in collision and copy their bodies into the dense arrays
+    collect_overlapping_pairs();
+    build_bodies();
 
-        // 2. Calculate corrections for all detected pairs
-        auto corrections = calculate_all_corrections(overlapping_pairs);
+    // 2. Split the pairs into islands of bodies that can push each other
+    build_islands();
+    stats.warm_started_pairs = match_contact_cache();
 
-        // 3. Apply accumulated corrections to the entity transforms
-        apply_corrections(corrections);
+    // 3. Start every island from last frame's corrections; a resting island is already solved after this
+    island_active.assign(island_pair_offsets.size() - 1, 1);
+    std::for_each(
+        std::execution::par,
+        island_active.begin(),
+        island_active.end(),
+        [&](const std::uint8_t& active) {
+            const auto island = static_cast<std::uint32_t>(&active - island_active.data());
+            apply_corrections(get_island_bodies(island), pair_totals);
+        }
+    );
 
-        // 4. Check if overlaps still exist to decide whether to continue iterating
-        has_overlap = check_any_overlap();
+    // 4. Iterate the islands in parallel, one iteration per round; an island only touches its own
+    // pairs and dynamic bodies. After every round, look for overlaps the corrections created around
+    // the bodies moved in it, and rebuild the islands that gained pairs
+    stats.redetected_pairs = 0;
+    for (int round = 0; round < MAX_ROUNDS; ++round) {
+        island_active.resize(island_pair_offsets.size() - 1);
+        std::for_each(
+            std::execution::par,
+            island_active.begin(),
+            island_active.end(),
+            [&](std::uint8_t& active) {
+                const auto island = static_cast<std::uint32_t>(&active - island_active.data());
+                active = iterate_island(island) ? 1 : 0;
+            }
+        );
+        const bool any_active = std::find(island_active.begin(), island_active.end(), 1) != island_active.end();
+
+        const std::uint32_t found = redetect_pairs();
+        std::fill(body_moved.begin(), body_moved.end(), 0);
+        stats.redetected_pairs += found;
+
+        if (found > 0 || islands_stale) {
+            build_sides();
+            build_islands();
+            sync_island_budgets();
+        } else if (!any_active) {
+            break;
+        }
+    }
 
-        iteration++;
+    stats.island_count = static_cast<std::uint32_t>(island_pair_offsets.size() - 1);
+    stats.island_iterations.resize(stats.island_count);
+    stats.max_island_pairs = 0;
+    stats.max_iterations = 0;
+    stats.unsettled_islands = 0;
+    for (std::uint32_t island = 0; island < stats.island_count; ++island) {
+        const std::uint32_t iterations = body_iterations[get_island_bodies(island).front()];
+        stats.island_iterations[island] = iterations;
+        stats.max_island_pairs = std::max(stats.max_island_pairs, island_pair_offsets[island + 1] - island_pair_offsets[island]);
+        stats.max_iterations = std::max(stats.max_iterations, iterations);
+        if (check_any_overlap(get_island_pairs(island))) ++stats.unsettled_islands;
     }
+
+    // 5. Copy the corrected positions back to the entity transforms and remember the corrections
+    write_back_positions();
+    store_contact_cache();
 }
 
-// Collects unique pairs of entities that are currently colliding and are not triggers
-std::set<std::pair<entt::entity, entt::entity>> OverlapCorrectionSystem::collect_overlapping_pairs() const {
-    std::set<std::pair<entt::entity, entt::entity>> unique_pairs;
+// Runs one iteration of an island if it still overlaps and has iterations left; returns whether it ran.
+// Every body of an island holds the same counters, and an island with no overlap left gives up the
+// rest of its budget until it gains pairs again.
+bool OverlapCorrectionSystem::iterate_island(const std::uint32_t island) {
+    const auto solver_pairs = get_island_pairs(island);
+    const auto solver_bodies = get_island_bodies(island);
+    if (body_budgets[solver_bodies.front()] == 0) return false;
+
+    const bool has_overlap = check_any_overlap(solver_pairs);
+    if (has_overlap) {
+        // Calculate corrections for the island pairs
+        calculate_corrections(solver_pairs);
+
+        // Apply accumulated corrections to the body positions
+        apply_corrections(solver_bodies, pair_offsets);
+    }
 
-    const auto view = registry->view<BoxCollider2D, Transform>();
-    for (auto [entity, collider, transform] : view.each()) {
-        if (!collider.is_colliding || collider.is_trigger) continue;
+    for (const auto body : solver_bodies) {
+        if (has_overlap) {
+            ++body_iterations[body];
+            --body_budgets[body];
+        } else {
+            body_budgets[body] = 0;
+        }
+    }
+    return has_overlap;
+}
 
-        for (auto other : collider.colliding_entities) {
-            auto pair = std::minmax(entity, other);
-            unique_pairs.insert(pair);
+// Gives every body of an island the largest counters among its bodies. Islands only grow by merging,
+// and the bodies of new pairs were given a full budget, so an island that gained pairs gets it too.
+void OverlapCorrectionSystem::sync_island_budgets() {
+    for (std::uint32_t island = 0; island + 1 < island_body_offsets.size(); ++island) {
+        const auto solver_bodies = get_island_bodies(island);
+
+        std::uint32_t iterations = 0;
+        std::uint32_t budget = 0;
+        for (const auto body : solver_bodies) {
+            iterations = std::max(iterations, body_iterations[body]);
+            budget = std::max(budget, body_budgets[body]);
+        }
+        for (const auto body : solver_bodies) {
+            body_iterations[body] = iterations;
+            body_budgets[body] = budget;
         }
     }
+}
 
-    return unique_pairs;
+// Collects the pairs of the contact stream that are solid to each other and not both triggers.
+// The stream is already unique and sorted, so the pairs keep its order.
+void OverlapCorrectionSystem::collect_overlapping_pairs() {
+    solid_pairs.clear();
+
+    const auto *contact_stream = registry->ctx().find<ContactStream>();
+    if (!contact_stream) return;
+
+    for (const auto &[entity_a, entity_b] : contact_stream->get_pairs()) {
+        if (!registry->valid(entity_a) || !registry->valid(entity_b)) continue;
+
+        if (!is_solver_pair(registry->get<BoxCollider2D>(entity_a), registry->get<BoxCollider2D>(entity_b))) continue;
+        // Both may have fallen asleep since the contacts were found
+        if (is_immovable(entity_a) && is_immovable(entity_b)) continue;
+
+        solid_pairs.emplace_back(entity_a, entity_b);
+    }
+
+    collected_pair_count = solid_pairs.size();
 }
 
-// Utility function to accumulate correction in a map, summing displacements
-void OverlapCorrectionSystem::accumulate_correction(
-    std::unordered_map<entt::entity, CorrectionIntent>& corrections,
-    const entt::entity entity,
-    const Vector2& offset) {
+// Body of an entity, or NO_BODY if it is not in any pair
+std::uint32_t OverlapCorrectionSystem::find_body(const entt::entity entity) const {
+    const auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+    if (slot >= body_lookup.size() || body_lookup[slot] == NO_BODY) return NO_BODY;
 
-    corrections[entity].offset.x += offset.x;
-    corrections[entity].offset.y += offset.y;
+    // The slot may belong to another version of the identifier
+    const std::uint32_t body = body_lookup[slot];
+    return body_entities[body] == entity ? body : NO_BODY;
 }
 
-// Calculates corrections for all pairs using parallelism for performance
-std::unordered_map<entt::entity, CorrectionIntent> OverlapCorrectionSystem::calculate_all_corrections(
-    const std::set<std::pair<entt::entity, entt::entity>>& pairs) {
+// Static colliders, and sleeping bodies: SleepSystem wakes the ones touched by awake bodies before
+// this runs, and one met anyway (e.g. by redetection) is not pushed
+bool OverlapCorrectionSystem::is_immovable(const entt::entity entity) const {
+    return registry->get<BoxCollider2D>(entity).is_static || registry->all_of<Sleeping>(entity);
+}
 
-    std::vector pairs_vec(pairs.begin(), pairs.end());
+// Returns the body of an entity, adding it on first use
+std::uint32_t OverlapCorrectionSystem::add_body(const entt::entity entity) {
+    if (const std::uint32_t body = find_body(entity); body != NO_BODY) return body;
 
-    // Uses transform_reduce to map pairs to corrections and then aggregate them
-    return std::transform_reduce(
-        std::execution::par,
-        pairs_vec.begin(),
-        pairs_vec.end(),
-        std::unordered_map<entt::entity, CorrectionIntent>{},
-
-        // Merge function to aggregate partial results
-        [](auto a, const auto& b) {
-            for (auto& [entity, intent] : b) {
-                a[entity].offset.x += intent.offset.x;
-                a[entity].offset.y += intent.offset.y;
-            }
-            return a;
-        },
+    const auto slot = static_cast<std::size_t>(entt::to_entity(entity));
+    if (slot >= body_lookup.size()) {
+        body_lookup.resize(slot + 1, NO_BODY);
+    }
 
-        // Function that calculates corrections for a pair
-        [&](const auto& pair) {
-            std::unordered_map<entt::entity, CorrectionIntent> local;
+    const auto &collider = registry->get<BoxCollider2D>(entity);
+    const auto body = static_cast<std::uint32_t>(body_entities.size());
+
+    body_lookup[slot] = body;
+    body_entities.push_back(entity);
+    body_positions.push_back(registry->get<Transform>(entity).position);
+    body_start_positions.push_back(body_positions.back());
+    body_half_sizes.push_back({collider.width * 0.5f, collider.height * 0.5f});
+    body_static.push_back(is_immovable(entity) ? 1 : 0);
+    body_moved.push_back(0);
+    body_iterations.push_back(0);
+    body_budgets.push_back(MAX_ITERATIONS);
+    return body;
+}
 
-            auto entity_a = pair.first;
-            auto entity_b = pair.second;
+// Builds the dense bodies and pairs of the solid pairs
+void OverlapCorrectionSystem::build_bodies() {
+    // Only the slots of last frame's bodies have to be cleared
+    for (const auto entity : body_entities) {
+        body_lookup[entt::to_entity(entity)] = NO_BODY;
+    }
 
-            if (!registry->valid(entity_a) || !registry->valid(entity_b))
-                return local;
+    body_entities.clear();
+    body_positions.clear();
+    body_start_positions.clear();
+    body_half_sizes.clear();
+    body_static.clear();
+    body_moved.clear();
+    body_iterations.clear();
+    body_budgets.clear();
+    pairs.clear();
+
+    for (const auto &[entity_a, entity_b] : solid_pairs) {
+        const std::uint32_t body_a = add_body(entity_a);
+        const std::uint32_t body_b = add_body(entity_b);
+        pairs.push_back({body_a, body_b});
+    }
+
+    pair_offsets.resize(pairs.size() * 2);
+    build_sides();
+}
 
-            auto& collider_a = registry->get<BoxCollider2D>(entity_a);
-            auto& collider_b = registry->get<BoxCollider2D>(entity_b);
-            auto& transform_a = registry->get<Transform>(entity_a);
-            auto& transform_b = registry->get<Transform>(entity_b);
+// Builds the sides of each body's pairs with a counting sort
+void OverlapCorrectionSystem::build_sides() {
+    side_offsets.assign(body_entities.size() + 1, 0);
+    for (const auto &[body_a, body_b] : pairs) {
+        ++side_offsets[body_a + 1];
+        ++side_offsets[body_b + 1];
+    }
+    for (std::size_t body = 0; body < body_entities.size(); ++body) {
+        side_offsets[body + 1] += side_offsets[body];
+    }
 
-            const CollisionContext ctx{entity_a, entity_b, collider_a, collider_b, transform_a, transform_b};
-            const auto overlap = calculate_overlap(ctx);
+    body_sides.resize(pairs.size() * 2);
+    for (std::uint32_t pair = 0; pair < pairs.size(); ++pair) {
+        // side_offsets[body] is used as the write cursor of the body and ends up at its end
+        body_sides[side_offsets[pairs[pair].body_a]++] = pair * 2;
+        body_sides[side_offsets[pairs[pair].body_b]++] = pair * 2 + 1;
+    }
+    // Shift the cursors back into start offsets
+    for (std::size_t body = body_entities.size(); body > 0; --body) {
+        side_offsets[body] = side_offsets[body - 1];
+    }
+    side_offsets[0] = 0;
+}
 
-            // Don't have any penetration
-            if (!(overlap.x > 0 && overlap.y > 0)) return local;
+// Union-find root with path halving
+std::uint32_t OverlapCorrectionSystem::find_root(std::uint32_t body) {
+    while (body_parents[body] != body) {
+        body_parents[body] = body_parents[body_parents[body]];
+        body = body_parents[body];
+    }
+    return body;
+}
 
-            Vector2 correction = compute_correction(overlap);
+// Joins the dynamic bodies of every pair and groups pairs and bodies by island. A static body
+// can be in several islands at once since it never moves; its pairs go to the island of the
+// other body.
+void OverlapCorrectionSystem::build_islands() {
+    const auto body_count = static_cast<std::uint32_t>(body_entities.size());
 
-            // If any collider is static, apply the offset to the other one
-            if (collider_a.is_static || collider_b.is_static) {
-                if (collider_a.is_static && !collider_b.is_static) {
-                    accumulate_correction(local, entity_b, {correction.x * 2.0f, correction.y * 2.0f});
-                } else if (!collider_a.is_static && collider_b.is_static) {
-                    accumulate_correction(local, entity_a, {correction.x * 2.0f, correction.y * 2.0f});
-                } else {
-                    accumulate_correction(local, entity_a, correction);
-                    accumulate_correction(local, entity_b, {-correction.x, -correction.y});
-                }
-            } else {
-                accumulate_correction(local, entity_a, correction);
-                accumulate_correction(local, entity_b, {-correction.x, -correction.y});
-            }
+    body_parents.resize(body_count);
+    for (std::uint32_t body = 0; body < body_count; ++body) {
+        body_parents[body] = body;
+    }
+
+    for (const auto &[body_a, body_b] : pairs) {
+        if (body_static[body_a] || body_static[body_b]) continue;
+
+        // The lower root wins so islands are numbered by their first body
+        const std::uint32_t root_a = find_root(body_a);
+        const std::uint32_t root_b = find_root(body_b);
+        if (root_a < root_b) body_parents[root_b] = root_a;
+        else if (root_b < root_a) body_parents[root_a] = root_b;
+    }
 
-            return local;
+    // Number the islands in order of their first body
+    std::uint32_t island_count = 0;
+    body_islands.resize(body_count);
+    for (std::uint32_t body = 0; body < body_count; ++body) {
+        if (body_static[body]) {
+            body_islands[body] = NO_BODY;
+            continue;
         }
-    );
+
+        const std::uint32_t root = find_root(body);
+        body_islands[body] = root == body ? island_count++ : body_islands[root];
+    }
+
+    // Counting sort of the dynamic bodies and the pairs by island
+    island_body_offsets.assign(island_count + 1, 0);
+    island_pair_offsets.assign(island_count + 1, 0);
+    for (std::uint32_t body = 0; body < body_count; ++body) {
+        if (!body_static[body]) ++island_body_offsets[body_islands[body] + 1];
+    }
+    for (std::uint32_t pair = 0; pair < pairs.size(); ++pair) {
+        ++island_pair_offsets[get_pair_island(pair) + 1];
+    }
+    for (std::uint32_t island = 0; island < island_count; ++island) {
+        island_body_offsets[island + 1] += island_body_offsets[island];
+        island_pair_offsets[island + 1] += island_pair_offsets[island];
+    }
+
+    island_bodies.resize(island_body_offsets.back());
+    island_pairs.resize(pairs.size());
+
+    // The offsets are used as write cursors, then shifted back into start offsets
+    for (std::uint32_t body = 0; body < body_count; ++body) {
+        if (!body_static[body]) island_bodies[island_body_offsets[body_islands[body]]++] = body;
+    }
+    for (std::uint32_t pair = 0; pair < pairs.size(); ++pair) {
+        island_pairs[island_pair_offsets[get_pair_island(pair)]++] = pair;
+    }
+    for (std::uint32_t island = island_count; island > 0; --island) {
+        island_body_offsets[island] = island_body_offsets[island - 1];
+        island_pair_offsets[island] = island_pair_offsets[island - 1];
+    }
+    island_body_offsets[0] = 0;
+    island_pair_offsets[0] = 0;
 }
 
-// Applies corrections to entity transforms only if they exceed epsilon
-void OverlapCorrectionSystem::apply_corrections(
-    const std::unordered_map<entt::entity, CorrectionIntent>& corrections) {
+// Calculates the correction of every pair of an island; each pair only writes its own two offsets
+void OverlapCorrectionSystem::calculate_corrections(const std::span<const std::uint32_t> solver_pairs) {
+    for (const auto index : solver_pairs) {
+        const SolverPair &pair = pairs[index];
+        Vector2 &offset_a = pair_offsets[index * 2];
+        Vector2 &offset_b = pair_offsets[index * 2 + 1];
+
+        const auto overlap = calculate_overlap(
+            body_positions[pair.body_a], body_half_sizes[pair.body_a],
+            body_positions[pair.body_b], body_half_sizes[pair.body_b]
+        );
+
+        // Don't have any penetration
+        if (!(overlap.x > 0 && overlap.y > 0)) {
+            offset_a = {0.0f, 0.0f};
+            offset_b = {0.0f, 0.0f};
+            continue;
+        }
 
-    for (auto& [entity, intent] : corrections) {
-        if (!registry->valid(entity)) continue;
+        // Pushes `a` away from `b`; `b` gets the opposite
+        const Vector2 correction = compute_correction(overlap);
+
+        // If one collider is static, the other one takes the whole offset
+        if (body_static[pair.body_a]) {
+            offset_a = {0.0f, 0.0f};
+            offset_b = {-correction.x * 2.0f, -correction.y * 2.0f};
+        } else if (body_static[pair.body_b]) {
+            offset_a = {correction.x * 2.0f, correction.y * 2.0f};
+            offset_b = {0.0f, 0.0f};
+        } else {
+            offset_a = correction;
+            offset_b = {-correction.x, -correction.y};
+        }
+
+        pair_totals[index * 2] = Vector2Add(pair_totals[index * 2], offset_a);
+        pair_totals[index * 2 + 1] = Vector2Add(pair_totals[index * 2 + 1], offset_b);
+    }
+}
+
+// Sums the offsets of each body's pairs, in pair order, and applies them only if they exceed epsilon
+void OverlapCorrectionSystem::apply_corrections(
+    const std::span<const std::uint32_t> solver_bodies,
+    const std::vector<Vector2>& offsets) {
+
+    for (const auto body : solver_bodies) {
+        Vector2 offset{0.0f, 0.0f};
+        for (std::uint32_t side = side_offsets[body]; side < side_offsets[body + 1]; ++side) {
+            offset.x += offsets[body_sides[side]].x;
+            offset.y += offsets[body_sides[side]].y;
+        }
 
-        auto& transform = registry->get<Transform>(entity);
-        bool apply_x = std::abs(intent.offset.x) > EPSILON;
-        bool apply_y = std::abs(intent.offset.y) > EPSILON;
+        bool apply_x = std::abs(offset.x) > EPSILON;
+        bool apply_y = std::abs(offset.y) > EPSILON;
 
         if (apply_x || apply_y) {
-            transform.position = Vector2Add(transform.position, intent.offset);
+            body_positions[body] = Vector2Add(body_positions[body], offset);
+            body_moved[body] = 1;
         }
     }
 }
 
 // Checks if there is still any overlap after applying corrections
-bool OverlapCorrectionSystem::check_any_overlap() const {
-    const auto view = registry->view<BoxCollider2D, Transform>();
+bool OverlapCorrectionSystem::check_any_overlap(const std::span<const std::uint32_t> solver_pairs) const {
+    for (const auto index : solver_pairs) {
+        const SolverPair &pair = pairs[index];
+        const auto overlap = calculate_overlap(
+            body_positions[pair.body_a], body_half_sizes[pair.body_a],
+            body_positions[pair.body_b], body_half_sizes[pair.body_b]
+        );
+
+        if (overlap.x > 0 && overlap.y > 0) return true;
+    }
+    return false;
+}
+
+// Merges this frame's pairs with the cache, both sorted. A pair found in the cache whose relative
+// position moved less than WARM_START_THRESHOLD since last frame starts from its cached correction;
+// every other pair starts from zero. The move also has to be under half the cached correction:
+// a pair that was pushed apart and then stayed where the solver left it has moved by the whole
+// correction, and applying it again would open a gap. Returns the number of warm-started pairs.
+std::uint32_t OverlapCorrectionSystem::match_contact_cache() {
+    pair_totals.assign(pairs.size() * 2, {0.0f, 0.0f});
+    pair_separations.resize(pairs.size());
+
+    std::uint32_t warm_started = 0;
+    auto cached = contact_cache.begin();
+
+    for (std::uint32_t pair = 0; pair < pairs.size(); ++pair) {
+        const auto &[body_a, body_b] = pairs[pair];
+        pair_separations[pair] = Vector2Subtract(body_positions[body_a], body_positions[body_b]);
+
+        while (cached != contact_cache.end() && cached->pair < solid_pairs[pair]) ++cached;
+        if (cached == contact_cache.end() || cached->pair != solid_pairs[pair]) continue;
+
+        const Vector2 motion = Vector2Subtract(pair_separations[pair], cached->separation);
+        const float correction = Vector2Length(Vector2Subtract(cached->offset_a, cached->offset_b));
+        const float threshold = std::min(WARM_START_THRESHOLD, correction * 0.5f);
+        if (Vector2LengthSqr(motion) >= threshold * threshold) continue;
+
+        pair_totals[pair * 2] = cached->offset_a;
+        pair_totals[pair * 2 + 1] = cached->offset_b;
+        ++warm_started;
+    }
 
-    for (auto [entity, collider, transform] : view.each()) {
-        if (!collider.is_colliding || collider.is_trigger) continue;
+    return warm_started;
+}
 
-        for (const auto other : collider.colliding_entities) {
-            if (!registry->valid(entity) || !registry->valid(other)) continue;
+// Keeps the total correction of every pair for the next frame. Redetected pairs were appended
+// after the sorted ones from the ContactStream, so the cache is sorted again.
+void OverlapCorrectionSystem::store_contact_cache() {
+    next_contact_cache.clear();
+    for (std::uint32_t pair = 0; pair < pairs.size(); ++pair) {
+        next_contact_cache.push_back({
+            solid_pairs[pair], pair_separations[pair], pair_totals[pair * 2], pair_totals[pair * 2 + 1]
+        });
+    }
 
-            auto& collider_a = registry->get<BoxCollider2D>(entity);
-            auto& collider_b = registry->get<BoxCollider2D>(other);
-            auto& transform_a = registry->get<Transform>(entity);
-            auto& transform_b = registry->get<Transform>(other);
+    if (pairs.size() > collected_pair_count) {
+        std::sort(next_contact_cache.begin(), next_contact_cache.end(), [](const CachedContact &a, const CachedContact &b) {
+            return a.pair < b.pair;
+        });
+    }
+    contact_cache.swap(next_contact_cache);
+}
 
-            const CollisionContext ctx{entity, other, collider_a, collider_b, transform_a, transform_b};
-            const auto overlap = calculate_overlap(ctx);
+// Colliders that push each other out when they overlap: not both triggers, solid to each other and
+// not both static (nothing could move; the broadphase never reports these anyway)
+bool OverlapCorrectionSystem::is_solver_pair(const BoxCollider2D &collider_a, const BoxCollider2D &collider_b) {
+    if (!collider_a.can_collide_with(collider_b)) return false;
+    if (collider_a.is_trigger && collider_b.is_trigger) return false;
+    if (!collider_a.is_solid_with(collider_b)) return false;
+    return !(collider_a.is_static && collider_b.is_static);
+}
 
-            if (overlap.x > 0 && overlap.y > 0) return true;
+// Looks around every body moved since the last search for colliders it overlaps now but has no pair
+// with, and appends them as new pairs. The broadphase still holds the bounds of the start of the frame,
+// which are exact for every collider except the bodies the solver displaced: it is queried with the
+// exact corrected bounds of the moved body, and displaced bodies are found by their corrected position
+// in displaced_grid instead. Returns the number of new pairs.
+std::uint32_t OverlapCorrectionSystem::redetect_pairs() {
+    thread_local std::vector<entt::entity> candidates;
+
+    islands_stale = false;
+    const auto *spatial_query = registry->ctx().find<SpatialQuery>();
+    if (!spatial_query) return 0;
+
+    // Bin the displaced bodies; only the moved ones change cell since the last search
+    constexpr float absent = std::numeric_limits<float>::quiet_NaN();
+    float max_half_extent = 0.0f;
+    displaced_centers.resize(body_entities.size());
+    for (std::size_t body = 0; body < body_entities.size(); ++body) {
+        const bool displaced = body_positions[body].x != body_start_positions[body].x ||
+                               body_positions[body].y != body_start_positions[body].y;
+        displaced_centers[body] = displaced ? body_positions[body] : Vector2{absent, absent};
+        if (displaced) {
+            max_half_extent = std::max({max_half_extent, body_half_sizes[body].x, body_half_sizes[body].y});
         }
     }
-    return false;
+    displaced_grid.update(displaced_centers);
+    const int margin = static_cast<int>(std::ceil(max_half_extent / displaced_grid.get_effective_cell_size()));
+
+    redetected_pairs.clear();
+    for (std::uint32_t body = 0; body < body_entities.size(); ++body) {
+        if (!body_moved[body] || body_static[body]) continue;
+
+        const entt::entity entity = body_entities[body];
+        const auto &collider = registry->get<BoxCollider2D>(entity);
+        const Vector2 position = body_positions[body];
+        const Vector2 half_size = body_half_sizes[body];
+
+        const auto test_candidate = [&](const entt::entity other, const std::uint32_t other_body,
+                                         const Vector2 other_position, const BoxCollider2D &other_collider) {
+            if (!is_solver_pair(collider, other_collider)) return;
+
+            const auto overlap = calculate_overlap(
+                position, half_size,
+                other_position, {other_collider.width * 0.5f, other_collider.height * 0.5f}
+            );
+            if (!(overlap.x > 0 && overlap.y > 0)) return;
+
+            // A sleeping body pushed by a correction wakes up, or a resting crowd would act as a wall
+            if (registry->all_of<Sleeping>(other)) {
+                wake_body(*registry, other);
+                if (other_body != NO_BODY) {
+                    body_static[other_body] = 0;
+                    body_budgets[other_body] = MAX_ITERATIONS;
+                    islands_stale = true;
+                }
+            }
+
+            // Already solved together
+            if (other_body != NO_BODY) {
+                for (std::uint32_t side = side_offsets[body]; side < side_offsets[body + 1]; ++side) {
+                    const SolverPair &pair = pairs[body_sides[side] / 2];
+                    if (pair.body_a == other_body || pair.body_b == other_body) return;
+                }
+            }
+
+            redetected_pairs.push_back(std::minmax(entity, other));
+        };
+
+        const Rectangle area{position.x - half_size.x, position.y - half_size.y, half_size.x * 2.0f, half_size.y * 2.0f};
+        spatial_query->query_region(area, candidates, collider.mask);
+
+        for (const auto other : candidates) {
+            if (other == entity || !registry->valid(other)) continue;
+
+            // The broadphase bounds of a displaced body are stale; it is tested from the grid below
+            const std::uint32_t other_body = find_body(other);
+            if (other_body != NO_BODY && !std::isnan(displaced_centers[other_body].x)) continue;
+
+            test_candidate(other, other_body, registry->get<Transform>(other).position, registry->get<BoxCollider2D>(other));
+        }
+
+        displaced_grid.for_each_item(area, margin, [&](const std::uint32_t other_body) {
+            if (other_body == body) return;
+
+            const entt::entity other = body_entities[other_body];
+            test_candidate(other, other_body, body_positions[other_body], registry->get<BoxCollider2D>(other));
+        });
+    }
+
+    // Two moved bodies find each other twice
+    std::sort(redetected_pairs.begin(), redetected_pairs.end());
+    redetected_pairs.erase(std::unique(redetected_pairs.begin(), redetected_pairs.end()), redetected_pairs.end());
+
+    for (const auto &[entity_a, entity_b] : redetected_pairs) {
+        const std::uint32_t body_a = add_body(entity_a);
+        const std::uint32_t body_b = add_body(entity_b);
+
+        // The islands these bodies end up in get a full budget for the new pair
+        body_budgets[body_a] = MAX_ITERATIONS;
+        body_budgets[body_b] = MAX_ITERATIONS;
+
+        pairs.push_back({body_a, body_b});
+        solid_pairs.emplace_back(entity_a, entity_b);
+        pair_separations.push_back(Vector2Subtract(body_positions[body_a], body_positions[body_b]));
+    }
+
+    pair_offsets.resize(pairs.size() * 2);
+    pair_totals.resize(pairs.size() * 2, {0.0f, 0.0f});
+
+    return static_cast<std::uint32_t>(redetected_pairs.size());
+}
+
+void OverlapCorrectionSystem::write_back_positions() {
+    for (std::size_t body = 0; body < body_entities.size(); ++body) {
+        if (body_static[body]) continue;
+        registry->get<Transform>(body_entities[body]).position = body_positions[body];
+    }
 }
 
 // Calculates the delta vector and overlap values between two colliders
-OverlapResult OverlapCorrectionSystem::calculate_overlap(const CollisionContext& ctx) {
-    const float half_a_w = ctx.collider_a.width * 0.5f;
-    const float half_a_h = ctx.collider_a.height * 0.5f;
-    const float half_b_w = ctx.collider_b.width * 0.5f;
-    const float half_b_h = ctx.collider_b.height * 0.5f;
+OverlapResult OverlapCorrectionSystem::calculate_overlap(
+    const Vector2 position_a, const Vector2 half_size_a,
+    const Vector2 position_b, const Vector2 half_size_b) {
 
     const Vector2 delta = {
-        ctx.transform_a.position.x - ctx.transform_b.position.x,
-        ctx.transform_a.position.y - ctx.transform_b.position.y
+        position_a.x - position_b.x,
+        position_a.y - position_b.y
     };
 
-    const float overlap_x = (half_a_w + half_b_w) - std::abs(delta.x);
-    const float overlap_y = (half_a_h + half_b_h) - std::abs(delta.y);
+    const float overlap_x = (half_size_a.x + half_size_b.x) - std::abs(delta.x);
+    const float overlap_y = (half_size_a.y + half_size_b.y) - std::abs(delta.y);
 
     return {delta, overlap_x, overlap_y};
 }
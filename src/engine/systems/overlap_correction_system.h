@@ -4,36 +4,50 @@
 #define OVERLAP_CORRECTION_SYSTEM_H
 
 #include "system.h"
-#include <unordered_map>
-#include <set>
+#include <cstdint>
+#include <span>
+#include <vector>
 
+#include "engine/collision/contact_stream.h"
+#include "engine/collision/spatial_grid.h"
 #include "engine/components/components.h"
 
 
 namespace rpg {
-    struct BoxCollider2D;
-
-    struct CollisionContext {
-        entt::entity entity_a;
-        entt::entity entity_b;
-        BoxCollider2D &collider_a;
-        BoxCollider2D &collider_b;
-        Transform &transform_a;
-        Transform &transform_b;
-    };
-
     struct OverlapResult {
         Vector2 delta;
         float x;
         float y;
     };
 
-    struct CorrectionIntent {
-        Vector2 offset{0, 0};
+    // Per-frame solver statistics, stored in the registry context by OverlapCorrectionSystem
+    struct OverlapSolverStats {
+        std::uint32_t island_count = 0;
+        std::uint32_t max_island_pairs = 0;
+        // Largest iteration count of any island, i.e. what a single global solve would have run
+        std::uint32_t max_iterations = 0;
+        // Islands still overlapping after the last iteration
+        std::uint32_t unsettled_islands = 0;
+        // Pairs that started from last frame's correction
+        std::uint32_t warm_started_pairs = 0;
+        // Overlaps created by the corrections, found around the moved bodies and solved in the same frame
+        std::uint32_t redetected_pairs = 0;
+        // Iterations of each island, in island order
+        std::vector<std::uint32_t> island_iterations;
     };
 
     // A system that resolves 2D collisions by iteratively correcting overlaps between entities with BoxCollider2D and Transform components.
     // Ensures stable physics simulation by minimizing penetration in a performance-efficient manner.
+    // The solver works on dense copies of the bodies in contact, split into islands of dynamic bodies
+    // connected through contacts. Islands iterate in parallel, in lockstep rounds, each stopping as
+    // soon as it has no overlap left: every pair computes its correction, then every body sums the
+    // corrections of its own pairs. No buffer is reallocated once it has grown to the size of the scene.
+    // The total correction of every pair is cached across frames; a pair whose bodies kept their
+    // relative position starts from last frame's correction, so resting contacts settle at once.
+    // After every round, overlaps the corrections created are searched for around the bodies moved in
+    // that round only: through the SpatialQuery in the registry context for the colliders the solver
+    // did not move, and by corrected position for the ones it did. An island that gains pairs gets
+    // MAX_ITERATIONS more iterations to solve them.
     class OverlapCorrectionSystem final : public System {
     public:
         explicit OverlapCorrectionSystem(entt::registry *registry);
@@ -41,32 +55,149 @@ namespace rpg {
         void run(float delta_time) override;
 
     private:
+        // Two bodies in contact, as indices into the body arrays
+        struct SolverPair {
+            std::uint32_t body_a;
+            std::uint32_t body_b;
+        };
+
+        // Correction a pair ended up applying last frame, and the relative position it started from
+        struct CachedContact {
+            EntityPair pair;
+            Vector2 separation;
+            Vector2 offset_a;
+            Vector2 offset_b;
+        };
+
         // Core steps separated into functions to ease maintenance
-        [[nodiscard]] std::set<std::pair<entt::entity, entt::entity> > collect_overlapping_pairs() const;
+        void collect_overlapping_pairs();
+
+        void build_bodies();
+
+        [[nodiscard]] bool is_immovable(entt::entity entity) const;
+
+        [[nodiscard]] std::uint32_t find_body(entt::entity entity) const;
+
+        std::uint32_t add_body(entt::entity entity);
+
+        void build_sides();
+
+        std::uint32_t find_root(std::uint32_t body);
+
+        void build_islands();
+
+        std::uint32_t match_contact_cache();
+
+        void store_contact_cache();
+
+        static bool is_solver_pair(const BoxCollider2D &collider_a, const BoxCollider2D &collider_b);
+
+        std::uint32_t redetect_pairs();
+
+        void sync_island_budgets();
+
+        // Island of a pair: the island of its dynamic body, or of body_a if both are dynamic
+        [[nodiscard]] std::uint32_t get_pair_island(const std::uint32_t pair) const {
+            const auto &[body_a, body_b] = pairs[pair];
+            return body_islands[body_static[body_a] ? body_b : body_a];
+        }
 
-        std::unordered_map<entt::entity, CorrectionIntent> calculate_all_corrections(
-            const std::set<std::pair<entt::entity, entt::entity> > &pairs
-        );
+        [[nodiscard]] std::span<const std::uint32_t> get_island_pairs(const std::uint32_t island) const {
+            return {island_pairs.data() + island_pair_offsets[island], island_pair_offsets[island + 1] - island_pair_offsets[island]};
+        }
 
-        void apply_corrections(const std::unordered_map<entt::entity, CorrectionIntent> &corrections);
+        [[nodiscard]] std::span<const std::uint32_t> get_island_bodies(const std::uint32_t island) const {
+            return {island_bodies.data() + island_body_offsets[island], island_body_offsets[island + 1] - island_body_offsets[island]};
+        }
 
-        [[nodiscard]] bool check_any_overlap() const;
+        bool iterate_island(std::uint32_t island);
+
+        void calculate_corrections(std::span<const std::uint32_t> solver_pairs);
+
+        void apply_corrections(std::span<const std::uint32_t> solver_bodies, const std::vector<Vector2> &offsets);
+
+        [[nodiscard]] bool check_any_overlap(std::span<const std::uint32_t> solver_pairs) const;
+
+        void write_back_positions();
+
+        // Pairs from the ContactStream that this system solves, sorted, followed by the redetected ones
+        std::vector<EntityPair> solid_pairs;
+        std::size_t collected_pair_count = 0;
+        std::vector<EntityPair> redetected_pairs;
+
+        // Bodies of the solid pairs, in order of first appearance
+        std::vector<entt::entity> body_entities;
+        std::vector<Vector2> body_positions;
+        std::vector<Vector2> body_start_positions;
+        std::vector<Vector2> body_half_sizes;
+        std::vector<std::uint8_t> body_static;
+        // Set when a correction moved the body since the last redetection
+        std::vector<std::uint8_t> body_moved;
+        // Iterations the island of each body has run this frame, and how many it may still run
+        std::vector<std::uint32_t> body_iterations;
+        std::vector<std::uint32_t> body_budgets;
+
+        // Bodies moved away from their broadphase bounds, binned by corrected position (NaN for the
+        // others), so redetection finds them where they are now
+        SpatialGrid displaced_grid;
+        std::vector<Vector2> displaced_centers;
+        // Set when redetection woke a body, which changes the islands even without new pairs
+        bool islands_stale = false;
+
+        // Body index of each entity, indexed by the entity part of its identifier
+        std::vector<std::uint32_t> body_lookup;
+
+        std::vector<SolverPair> pairs;
+
+        // Offsets computed for both sides of each pair: [2 * pair] for body_a, [2 * pair + 1] for body_b
+        std::vector<Vector2> pair_offsets;
+        // Sum of the offsets applied by each pair this frame, laid out the same way, and the
+        // relative position (a - b) of each pair before solving
+        std::vector<Vector2> pair_totals;
+        std::vector<Vector2> pair_separations;
+
+        // Contacts of the last frame, sorted by pair
+        std::vector<CachedContact> contact_cache;
+        std::vector<CachedContact> next_contact_cache;
+
+        // Pair sides of each body in CSR form: the sides of body `i` are
+        // body_sides[side_offsets[i] .. side_offsets[i + 1]), in pair order.
+        std::vector<std::uint32_t> side_offsets;
+        std::vector<std::uint32_t> body_sides;
+
+        // Union-find parents of the bodies; static bodies are never joined, so they do not link islands
+        std::vector<std::uint32_t> body_parents;
+        // Island of each body, or NO_BODY for static ones
+        std::vector<std::uint32_t> body_islands;
+
+        // Pairs and dynamic bodies of each island in CSR form, both in ascending order
+        std::vector<std::uint32_t> island_pair_offsets;
+        std::vector<std::uint32_t> island_pairs;
+        std::vector<std::uint32_t> island_body_offsets;
+        std::vector<std::uint32_t> island_bodies;
+        // Islands that ran an iteration in the last round
+        std::vector<std::uint8_t> island_active;
 
         // Helper functions for individual calculation
-        static OverlapResult calculate_overlap(const CollisionContext &ctx);
+        static OverlapResult calculate_overlap(Vector2 position_a, Vector2 half_size_a,
+                                               Vector2 position_b, Vector2 half_size_b);
 
         static Vector2 compute_correction(const OverlapResult &overlap);
 
-        static void accumulate_correction(
-            std::unordered_map<entt::entity, CorrectionIntent> &corrections,
-            entt::entity entity,
-            const Vector2 &offset
-        );
-
         // Maximum number of iterations to resolve overlaps, balancing stability and performance (default: 5).
         static constexpr int MAX_ITERATIONS = 5;
         // Minimum threshold for applying corrections to avoid jittering (default: 0.001f).
         static constexpr float EPSILON = 0.001f;
+        // Largest change of a pair's relative position since last frame for it to reuse the cached
+        // correction (default: 0.5f).
+        static constexpr float WARM_START_THRESHOLD = 0.5f;
+        // Lockstep rounds over all islands, bounding the extra iterations that islands gaining pairs
+        // can ask for (default: 15).
+        static constexpr int MAX_ROUNDS = 15;
+        // Cell size of the grid of displaced bodies, in world units (default: 64.0f).
+        static constexpr float DISPLACED_CELL_SIZE = 64.0f;
+        // Marks an entity slot without a body.
+        static constexpr std::uint32_t NO_BODY = 0xFFFFFFFF;
     };
 } // namespace rpg
 
@@ -5,31 +5,92 @@
 #include "shape_render_system.h"
 #include <raylib.h>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "raymath.h"
+#include "engine/fixed_timestep.h"
 #include "engine/components/components.h"
 #include "entt/entt.hpp"
 
 
 namespace rpg {
-    RenderSystem::RenderSystem(entt::registry *registry): System(registry) {
+    namespace {
+        // Farthest a rectangle centered on its position reaches at any rotation
+        float get_reach(const ColorRect &color_rect) {
+            return std::hypot(color_rect.width, color_rect.height) * 0.5f;
+        }
+    }
+
+    RenderSystem::RenderSystem(entt::registry *registry, const Camera2D *camera, RenderBackend *backend)
+        : System(registry), camera(camera), backend(backend) {
+        registry->on_construct<ColorRect>().connect<&RenderSystem::on_shape_changed>(this);
+        registry->on_update<ColorRect>().connect<&RenderSystem::on_shape_changed>(this);
+        registry->on_destroy<ColorRect>().connect<&RenderSystem::on_shape_changed>(this);
+        registry->on_construct<MovementData>().connect<&RenderSystem::on_shape_changed>(this);
+        registry->on_destroy<MovementData>().connect<&RenderSystem::on_shape_changed>(this);
+        registry->on_update<Transform>().connect<&RenderSystem::on_transform_changed>(this);
+    }
+
+    RenderSystem::~RenderSystem() {
+        registry->on_construct<ColorRect>().disconnect(this);
+        registry->on_update<ColorRect>().disconnect(this);
+        registry->on_destroy<ColorRect>().disconnect(this);
+        registry->on_construct<MovementData>().disconnect(this);
+        registry->on_destroy<MovementData>().disconnect(this);
+        registry->on_update<Transform>().disconnect(this);
+    }
+
+    // A shape was added, removed or edited, or an entity started or stopped moving
+    void RenderSystem::on_shape_changed(entt::registry &, entt::entity) {
+        culler.invalidate_statics();
+    }
+
+    // A shape that does not move on its own was moved through registry.patch/replace
+    void RenderSystem::on_transform_changed(entt::registry &registry, const entt::entity entity) {
+        if (registry.all_of<ColorRect>(entity) && !registry.all_of<MovementData>(entity)) {
+            culler.invalidate_statics();
+        }
+    }
+
+    void RenderSystem::update_culler() {
+        if (culler.needs_statics()) {
+            culler.clear_statics();
+            for (auto [entity, color_rect, transform]: registry->view<ColorRect, Transform>(entt::exclude<MovementData>).each()) {
+                culler.add_static(entity, transform.position, get_reach(color_rect));
+            }
+        }
+
+        culler.clear_moving();
+        for (auto [entity, color_rect, transform, movement_data]: registry->view<ColorRect, Transform, MovementData>().each()) {
+            culler.add_moving(entity, get_render_position(*registry, entity, transform), get_reach(color_rect));
+        }
+
+        culler.update();
     }
 
     void RenderSystem::run(float dt) {
-        auto view = registry->view<ColorRect, Transform>();
+        update_culler();
+
+        const Vector2 screen_size = backend->get_screen_size();
+        culler.query(get_visible_area(*camera, screen_size.x, screen_size.y), visible_entities);
+
+        auto &render_stats = registry->ctx().emplace<RenderStats>();
+        render_stats.drawn_shapes = static_cast<std::uint32_t>(visible_entities.size());
+        render_stats.culled_shapes = culler.size() - render_stats.drawn_shapes;
 
-        for (const auto entity: view) {
-            auto &color_rect = view.get<ColorRect>(entity);
-            const auto &transform = view.get<rpg::Transform>(entity);
+        for (const auto entity: visible_entities) {
+            const auto &color_rect = registry->get<ColorRect>(entity);
+            const auto &transform = registry->get<rpg::Transform>(entity);
+            const Vector2 position = get_render_position(*registry, entity, transform);
 
             const Rectangle rec(
-                transform.position.x,
-                transform.position.y,
+                position.x,
+                position.y,
                 color_rect.width, color_rect.height
             );
 
-            DrawRectanglePro(
+            backend->draw_rectangle(
                 rec,
                 Vector2(color_rect.width, color_rect.height)/2,
                 transform.rotation,
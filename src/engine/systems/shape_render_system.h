@@ -6,12 +6,30 @@
 #define RENDER_SYSTEM_H
 #include "system.h"
 
+#include <vector>
+
+#include "raylib.h"
+#include "engine/render/render_backend.h"
+#include "engine/render/view_culler.h"
+
 namespace rpg {
 
+// Draws the ColorRects seen by the camera; the ones off screen are culled through a ViewCuller.
 class RenderSystem final : public System {
+    const Camera2D *camera;
+    RenderBackend *backend;
+    ViewCuller culler;
+    std::vector<entt::entity> visible_entities;
+
+    void on_shape_changed(entt::registry &registry, entt::entity entity);
+
+    void on_transform_changed(entt::registry &registry, entt::entity entity);
+
+    void update_culler();
 
 public:
-    explicit RenderSystem(entt::registry* registry);
+    RenderSystem(entt::registry* registry, const Camera2D *camera, RenderBackend *backend);
+    ~RenderSystem() override;
     void run(float dt) override;
 };
 
@@ -0,0 +1,94 @@
+// sleep_system.cpp
+// Purpose: Sleep and wake rules for resting bodies.
+
+#include "sleep_system.h"
+
+#include <utility>
+
+#include "raymath.h"
+#include "engine/collision/contact_stream.h"
+#include "engine/components/components.h"
+
+namespace rpg {
+
+    void wake_body(entt::registry &registry, const entt::entity entity) {
+        if (!registry.all_of<Sleeping>(entity)) return;
+
+        registry.remove<Sleeping>(entity);
+        if (auto *sleep_state = registry.try_get<SleepState>(entity)) {
+            sleep_state->still_frames = 0;
+        }
+    }
+
+    SleepSystem::SleepSystem(entt::registry *registry): System(registry) {
+    }
+
+    // Wakes the sleeping side of every contact with an awake, non-static body
+    void SleepSystem::wake_touched_bodies() {
+        const auto *contact_stream = registry->ctx().find<ContactStream>();
+        if (!contact_stream) return;
+
+        const auto is_awake_body = [&](const entt::entity entity) {
+            const auto *collider = registry->try_get<BoxCollider2D>(entity);
+            return collider && !collider->is_static && !registry->all_of<Sleeping>(entity);
+        };
+
+        for (const auto &[entity_a, entity_b]: contact_stream->get_pairs()) {
+            if (!registry->valid(entity_a) || !registry->valid(entity_b)) continue;
+
+            if (registry->all_of<Sleeping>(entity_a) && is_awake_body(entity_b)) {
+                wake_body(*registry, entity_a);
+            } else if (registry->all_of<Sleeping>(entity_b) && is_awake_body(entity_a)) {
+                wake_body(*registry, entity_b);
+            }
+        }
+    }
+
+    // Wakes the sleeping bodies that were given a velocity, e.g. by gameplay code
+    void SleepSystem::wake_moving_bodies() {
+        // Removing the current entity from the iterated storage is allowed by EnTT. Waking moves the
+        // body within the MovementData storage (MoveSystem's group owns it), so iterate the tags.
+        auto view = registry->view<MovementData, Sleeping>();
+        view.use<Sleeping>();
+        for (auto [entity, movement_data]: view.each()) {
+            if (Vector2LengthSqr(movement_data.velocity) > SLEEP_VELOCITY * SLEEP_VELOCITY) {
+                wake_body(*registry, entity);
+            }
+        }
+    }
+
+    // Counts the frames each awake body has been resting and puts it to sleep after SLEEP_FRAMES
+    void SleepSystem::update_resting_bodies() {
+        // Falling asleep reorders the storages owned by MoveSystem's group, so iterate the colliders
+        auto view = registry->view<Transform, MovementData, BoxCollider2D>(entt::exclude<Sleeping, Input>);
+        view.use<BoxCollider2D>();
+
+        for (auto [entity, transform, movement_data, box_collider]: view.each()) {
+            if (box_collider.is_static) continue;
+
+            auto &sleep_state = registry->get_or_emplace<SleepState>(entity);
+            const Vector2 drift = Vector2Subtract(transform.position, sleep_state.rest_position);
+
+            if (Vector2LengthSqr(movement_data.velocity) > SLEEP_VELOCITY * SLEEP_VELOCITY ||
+                Vector2LengthSqr(drift) > SLEEP_DISPLACEMENT * SLEEP_DISPLACEMENT) {
+                sleep_state.rest_position = transform.position;
+                sleep_state.still_frames = 0;
+                continue;
+            }
+
+            if (++sleep_state.still_frames >= SLEEP_FRAMES) {
+                // Nothing moves it while asleep, so it is also where it is drawn from
+                movement_data.velocity = {0.0f, 0.0f};
+                movement_data.previous_position = transform.position;
+                registry->emplace<Sleeping>(entity);
+            }
+        }
+    }
+
+    void SleepSystem::run(float dt) {
+        wake_touched_bodies();
+        wake_moving_bodies();
+        update_resting_bodies();
+    }
+
+} // namespace rpg
@@ -0,0 +1,46 @@
+// sleep_system.h
+// Purpose: Puts resting bodies to sleep and wakes them up. A body with MovementData and
+// BoxCollider2D falls asleep after its velocity and its drift from where it came to rest stay
+// below thresholds for SLEEP_FRAMES frames in a row. Contact with an awake body, a velocity
+// set from outside or an explicit wake_body() call wakes it again. Bodies with Input never sleep.
+
+#ifndef SLEEP_SYSTEM_H
+#define SLEEP_SYSTEM_H
+
+#include <cstdint>
+
+#include "system.h"
+#include "raylib.h"
+#include "entt/entt.hpp"
+
+namespace rpg {
+
+    // Wakes a sleeping body, e.g. before moving it from gameplay code
+    void wake_body(entt::registry &registry, entt::entity entity);
+
+    // Runs between CollisionDetectionSystem and OverlapCorrectionSystem, so the bodies woken by this
+    // frame's contacts are already movable when the overlaps are solved.
+    class SleepSystem final : public System {
+        void wake_touched_bodies();
+
+        void wake_moving_bodies();
+
+        void update_resting_bodies();
+
+    public:
+        explicit SleepSystem(entt::registry *registry);
+
+        void run(float dt) override;
+
+    private:
+        // Speed below which a body counts as resting (default: 1.0f).
+        static constexpr float SLEEP_VELOCITY = 1.0f;
+        // Distance a resting body may drift from where it came to rest (default: 0.5f).
+        static constexpr float SLEEP_DISPLACEMENT = 0.5f;
+        // Resting frames in a row before a body falls asleep (default: 60).
+        static constexpr std::uint32_t SLEEP_FRAMES = 60;
+    };
+
+} // namespace rpg
+
+#endif // SLEEP_SYSTEM_H
@@ -1,33 +1,29 @@
-// SpriteRendererSystem handles 2D sprite rendering using a texture atlas.
+// SpriteRendererSystem handles 2D sprite rendering using a texture atlas of one or more pages.
 // It uses data from the Transform and Sprite components (via entt ECS).
-// Rendering is done via rlgl (low-level API), so it's fully manual:
-// UVs, rotation, and vertex submission are computed and pushed per frame.
+// Quads go to a RenderBackend (rlgl when drawing to a window), so it's fully manual:
+// UVs, rotation, and vertex submission are computed on the CPU. Sprites without MovementData
+// are baked into per-chunk vertex arrays that are only rebuilt when one of their sprites changes;
+// moving sprites are rebuilt every frame.
 
 
 #include "sprite_renderer_system.h"
+#include <algorithm>
+#include <cmath>
+#include <execution>
 #include <fstream>
 #include <iostream>
+#include <utility>
 #include "nlohmann/json.hpp"
-#include "rlgl.h"
+#include "engine/fixed_timestep.h"
 #include "engine/components/components.h"
+#include "utils/texture_packer.h"
 
 namespace rpg {
 
-    // Loads texture atlas image and JSON metadata.
+    // Loads the JSON metadata and every texture atlas page it refers to.
     // This must succeed for the renderer to function correctly.
     bool SpriteRendererSystem::load_resources() {
-        const Image atlas_image = LoadImage(RESOURCE_PATH"/atlas.png");
-
-        if (!atlas_image.data) {
-            std::cerr << "Failed to load " << RESOURCE_PATH "/atlas.png" << std::endl;
-            return false;
-        }
-
-        // Upload the atlas to GPU and unload the CPU-side image.
-        atlas_texture = LoadTextureFromImage(atlas_image);
-        UnloadImage(atlas_image);
-
-        // Open JSON file with sprite UV coordinates and dimensions.
+        // Open JSON file with sprite UV coordinates, dimensions and pages.
         std::ifstream json_file(RESOURCE_PATH "/atlas.json");
         if (!json_file.is_open()) {
             std::cerr << "Failed to open " << RESOURCE_PATH "/atlas.json" << std::endl;
@@ -40,16 +36,37 @@ namespace rpg {
             return false;
         }
 
+        // Atlases packed before pages existed have no "page" entries and a single page
+        int page_count = 1;
+        for (const auto &value: json_data) {
+            page_count = std::max(page_count, value.value("page", 0) + 1);
+        }
+
+        for (int page = 0; page < page_count; ++page) {
+            const std::string page_path = TexturePacker::get_page_path(RESOURCE_PATH "/atlas.png", page);
+            const Image page_image = LoadImage(page_path.c_str());
+
+            if (!page_image.data) {
+                std::cerr << "Failed to load " << page_path << std::endl;
+                atlas_pages.clear();
+                return false;
+            }
+
+            // Upload the page to GPU and unload the CPU-side image.
+            atlas_pages.push_back(backend->load_texture(page_image));
+            UnloadImage(page_image);
+        }
+
         return true;
     }
 
     // Calculates the four corners of a quad, applying 2D rotation around a pivot (origin).
-    // Results are stored in `verts_cache` for later GPU upload.
-    void SpriteRendererSystem::apply_rotation(
+    std::array<Vector2, 4> SpriteRendererSystem::apply_rotation(
         const Rectangle &dest,
         const Vector2 &origin,
         const float rotation_deg
     ) {
+        std::array<Vector2, 4> verts_cache;
         if (rotation_deg == 0.0f) {
             // No rotation: just offset by the origin.
             const float x = dest.x - origin.x;
@@ -81,24 +98,262 @@ namespace rpg {
                 y + (dx + dest.width) * sinRot + dy * cosRot
             }; // TR
         }
+        return verts_cache;
+    }
+
+    // Farthest a sprite's quad reaches from its position at any rotation; the quad spans
+    // (position - origin) .. (position - origin + atlas size) and rotates around the position.
+    float SpriteRendererSystem::get_reach(const Sprite &sprite) const {
+        const auto &region = sprite_atlas->get(sprite.handle);
+        const float width = std::abs(region.width);
+        const float height = std::abs(region.height);
+
+        const float origin_x = sprite.size.x * 0.5f;
+        const float origin_y = sprite.size.y * 0.5f;
+        return std::hypot(std::max(std::abs(origin_x), std::abs(width - origin_x)),
+                          std::max(std::abs(origin_y), std::abs(height - origin_y)));
+    }
+
+    // A sprite was added, removed or edited, or an entity started or stopped moving
+    void SpriteRendererSystem::on_sprite_changed(entt::registry &, const entt::entity entity) {
+        static_cache.mark_changed(entity);
+    }
+
+    // A sprite that does not move on its own was moved through registry.patch/replace
+    void SpriteRendererSystem::on_transform_changed(entt::registry &registry, const entt::entity entity) {
+        if (registry.all_of<Sprite>(entity) && !registry.all_of<MovementData>(entity)) {
+            static_cache.mark_changed(entity);
+        }
+    }
+
+    // Only moving sprites go through the culler; the static ones are culled by chunk
+    void SpriteRendererSystem::update_culler() {
+        culler.clear_moving();
+        for (auto [entity, transform, sprite, movement_data]: registry->view<rpg::Transform, Sprite, MovementData>().each()) {
+            culler.add_moving(entity, get_render_position(*registry, entity, transform), get_reach(sprite));
+        }
+
+        culler.update();
+    }
+
+    // Bucket of a sprite: its atlas page first, so each page is bound once per frame whatever
+    // blend modes its sprites use
+    std::uint32_t SpriteRendererSystem::get_draw_key(const Sprite &sprite) const {
+        const std::uint32_t page = sprite_atlas->get(sprite.handle).page;
+        const auto blend_mode = static_cast<std::uint32_t>(std::clamp(sprite.blend_mode, 0, static_cast<int>(BLEND_MODE_COUNT) - 1));
+        return page * BLEND_MODE_COUNT + blend_mode;
+    }
+
+    // Writes the four vertices of a sprite drawn at `position` to `quad`. Only reads the registry,
+    // so quads can be written from several threads at once.
+    void SpriteRendererSystem::write_quad(const entt::entity entity, const Vector2 position, SpriteVertex *quad) const {
+        const entt::registry &registry = *this->registry;
+        const auto &transform = registry.get<rpg::Transform>(entity);
+        const auto &sprite = registry.get<Sprite>(entity);
+
+        // Read-only: the flips below apply to this quad, never to the shared region
+        const auto &[region_width, height, sx, region_sy, sw, sh, page] = sprite_atlas->get(sprite.handle);
+
+        // Flip horizontally if width is negative
+        const bool flipX = region_width < 0;
+        const float width = std::abs(region_width);
+
+        // Adjust Y UV coordinate for vertically flipped sprites, by the normalized height
+        const float sy = height < 0 ? region_sy - sh : region_sy;
+
+        // Destination rectangle on screen
+        const Rectangle dest = {
+            position.x,
+            position.y,
+            width,
+            height
+        };
+
+        // Pivot point for rotation (centered on sprite)
+        const Vector2 origin = {
+            sprite.size.x * 0.5f,
+            sprite.size.y * 0.5f
+        };
+
+        // Compute final vertex positions with rotation
+        const auto corners = apply_rotation(dest, origin, transform.rotation);
+
+        // UV coordinates per corner (flipped if needed)
+        const float tx[4] = {
+            flipX ? sx + sw : sx,
+            flipX ? sx + sw : sx,
+            flipX ? sx : sx + sw,
+            flipX ? sx : sx + sw
+        };
+
+        const float ty[4] = {
+            sy,
+            sy + sh,
+            sy + sh,
+            sy
+        };
+
+        for (int i = 0; i < 4; ++i) {
+            quad[i] = {corners[i], {tx[i], ty[i]}, sprite.color};
+        }
+    }
+
+    // Gives every visible moving sprite a quad slot, grouped by draw key in visibility order, then
+    // writes the quads in parallel straight into their slots
+    void SpriteRendererSystem::build_moving_vertices() {
+        const auto count = static_cast<std::uint32_t>(visible_entities.size());
+        moving_keys.resize(count);
+        moving_slots.resize(count);
+
+        for (auto &bucket: draw_buckets) {
+            bucket.moving_begin = 0;
+            bucket.moving_count = 0;
+        }
+        for (std::uint32_t i = 0; i < count; ++i) {
+            moving_keys[i] = get_draw_key(registry->get<Sprite>(visible_entities[i]));
+            draw_buckets[moving_keys[i]].moving_count += 4;
+        }
+
+        std::uint32_t begin = 0;
+        for (auto &bucket: draw_buckets) {
+            bucket.moving_begin = begin;
+            begin += bucket.moving_count;
+        }
+
+        // Counting sort: bucket.moving_count is rebuilt while it hands out the slots
+        for (auto &bucket: draw_buckets) {
+            bucket.moving_count = 0;
+        }
+        for (std::uint32_t i = 0; i < count; ++i) {
+            auto &bucket = draw_buckets[moving_keys[i]];
+            moving_slots[i] = bucket.moving_begin + bucket.moving_count;
+            bucket.moving_count += 4;
+        }
+
+        if (moving_vertices.size() < begin) {
+            moving_vertices.resize(begin);
+        }
+
+        std::for_each(
+            std::execution::par,
+            visible_entities.begin(),
+            visible_entities.end(),
+            [this](const entt::entity &entity) {
+                const auto index = static_cast<std::size_t>(&entity - visible_entities.data());
+                const auto &transform = std::as_const(*registry).get<rpg::Transform>(entity);
+                // Moving sprites are drawn between the last two simulation states
+                write_quad(entity, get_render_position(*registry, entity, transform), moving_vertices.data() + moving_slots[index]);
+            }
+        );
+    }
+
+    // Draws the buckets in key order, changing the texture and the blend mode only between
+    // buckets. Within a bucket the scenery comes first, so bodies are drawn over it.
+    // Vertices go to the backend's quad buffer in runs that fit what is left of it. The backend
+    // draws the quads pending since its last draw when the texture or blend mode changes or the
+    // buffer starts over, so a bucket that fits is one draw call; every such draw is counted.
+    void SpriteRendererSystem::submit_buckets(RenderStats &render_stats) const {
+        render_stats.texture_switches = 0;
+        render_stats.blend_mode_switches = 0;
+        render_stats.sprite_vertices = 0;
+        render_stats.batch_flushes = 0;
+
+        std::uint32_t bound_page = NO_PAGE;
+        int blend_mode = BLEND_ALPHA;
+        std::uint32_t buffer_fill = 0;
+        std::uint32_t pending_vertices = 0;
+
+        // Called before every backend call that draws the pending quads
+        const auto count_flush = [&] {
+            if (pending_vertices > 0) {
+                ++render_stats.batch_flushes;
+            }
+            pending_vertices = 0;
+        };
+
+        // Starts the quad buffer over, keeping the texture, so a whole BATCH_VERTEX_CAPACITY fits in it
+        const auto reserve_buffer = [&] {
+            count_flush();
+            backend->reserve_vertices(BATCH_VERTEX_CAPACITY);
+            buffer_fill = 0;
+        };
+
+        const auto submit_range = [&](std::span<const SpriteVertex> vertices) {
+            render_stats.sprite_vertices += static_cast<std::uint32_t>(vertices.size());
+            while (!vertices.empty()) {
+                if (buffer_fill == BATCH_VERTEX_CAPACITY) {
+                    reserve_buffer();
+                }
+                const auto run = std::min<std::size_t>(vertices.size(), BATCH_VERTEX_CAPACITY - buffer_fill);
+
+                backend->draw_quads(vertices.first(run));
+
+                buffer_fill += static_cast<std::uint32_t>(run);
+                pending_vertices += static_cast<std::uint32_t>(run);
+                vertices = vertices.subspan(run);
+            }
+        };
+
+        reserve_buffer();
+
+        for (std::uint32_t key = 0; key < draw_buckets.size(); ++key) {
+            const auto &bucket = draw_buckets[key];
+            if (bucket.static_ranges.empty() && bucket.moving_count == 0) continue;
+
+            if (const std::uint32_t page = key / BLEND_MODE_COUNT; page != bound_page) {
+                count_flush();
+                backend->set_texture(atlas_pages[page].id);
+                bound_page = page;
+                ++render_stats.texture_switches;
+            }
+            if (const auto bucket_blend_mode = static_cast<int>(key % BLEND_MODE_COUNT); bucket_blend_mode != blend_mode) {
+                count_flush();
+                backend->set_blend_mode(bucket_blend_mode);
+                blend_mode = bucket_blend_mode;
+                ++render_stats.blend_mode_switches;
+            }
+
+            for (const auto &range: bucket.static_ranges) {
+                submit_range(range);
+            }
+            submit_range({moving_vertices.data() + bucket.moving_begin, bucket.moving_count});
+        }
+
+        count_flush();
+        if (blend_mode != BLEND_ALPHA) {
+            backend->set_blend_mode(BLEND_ALPHA);
+        }
+        backend->set_texture(0); // Unbind texture, drawing the last quads
     }
 
     // Constructor: Initializes the system and loads sprite atlas metadata into memory.
-    SpriteRendererSystem::SpriteRendererSystem(entt::registry *registry)
-        : System(registry) {
+    SpriteRendererSystem::SpriteRendererSystem(entt::registry *registry, const Camera2D *camera, RenderBackend *backend)
+        : System(registry), backend(backend), sprite_atlas(&registry->ctx().emplace<SpriteAtlas>()), camera(camera) {
+        registry->on_construct<Sprite>().connect<&SpriteRendererSystem::on_sprite_changed>(this);
+        registry->on_update<Sprite>().connect<&SpriteRendererSystem::on_sprite_changed>(this);
+        registry->on_destroy<Sprite>().connect<&SpriteRendererSystem::on_sprite_changed>(this);
+        registry->on_construct<MovementData>().connect<&SpriteRendererSystem::on_sprite_changed>(this);
+        registry->on_destroy<MovementData>().connect<&SpriteRendererSystem::on_sprite_changed>(this);
+        registry->on_update<rpg::Transform>().connect<&SpriteRendererSystem::on_transform_changed>(this);
+
+        // Sprites that exist before the system are cached like the ones added later
+        for (const auto entity: registry->view<Sprite>()) {
+            static_cache.mark_changed(entity);
+        }
+
         if (!load_resources()) return;
 
         // Iterate over each sprite entry in the atlas.json
-        for (auto &[key, value]: json_data.items()) {
-            std::string name = key;
+        for (auto &[name, value]: json_data.items()) {
 
             const float x = value["x"];
             const float y = value["y"];
             const float width = (value["width"]);
             const float height = (value["height"]);
+            const auto page = static_cast<std::uint32_t>(value.value("page", 0));
 
-            const auto tex_width = static_cast<float>(atlas_texture.width);
-            const auto tex_height = static_cast<float>(atlas_texture.height);
+            const auto tex_width = static_cast<float>(atlas_pages[page].width);
+            const auto tex_height = static_cast<float>(atlas_pages[page].height);
 
             // Calculate normalized UV texture coordinates (0.0 to 1.0)
             const float sx = x / tex_width;
@@ -106,87 +361,66 @@ namespace rpg {
             const float sw = width / tex_width;
             const float sh = height / tex_height;
 
-            // Store sprite metadata (dimensions + UVs) for fast access during rendering
-            normalized_uvs[name] = {width, height, sx, sy, sw, sh};
+            // Store sprite metadata (dimensions + UVs) under the sprite's handle; sprites spawned
+            // before the atlas was loaded already hold it
+            sprite_atlas->set_region(sprite_atlas->intern(name), {width, height, sx, sy, sw, sh, page});
         }
+
+        draw_buckets.resize(atlas_pages.size() * BLEND_MODE_COUNT);
     }
 
-    // Main rendering function. Called every frame to draw all entities with Transform + Sprite.
-    void SpriteRendererSystem::run(float dt) {
-        const auto view = registry->view<rpg::Transform, Sprite>();
+    SpriteRendererSystem::~SpriteRendererSystem() {
+        registry->on_construct<Sprite>().disconnect(this);
+        registry->on_update<Sprite>().disconnect(this);
+        registry->on_destroy<Sprite>().disconnect(this);
+        registry->on_construct<MovementData>().disconnect(this);
+        registry->on_destroy<MovementData>().disconnect(this);
+        registry->on_update<rpg::Transform>().disconnect(this);
+    }
 
-        if (atlas_texture.id == 0) {
+    // Main rendering function. Called every frame to draw the entities with Transform + Sprite
+    // that the camera can see.
+    void SpriteRendererSystem::run(float dt) {
+        if (atlas_pages.empty()) {
             std::cerr << "Atlas texture not loaded, skipping rendering." << std::endl;
             return;
         }
 
-        // Begin drawing textured quads using low-level rlgl API
-        rlSetTexture(atlas_texture.id);
-        rlBegin(RL_QUADS);
-
-        for (auto [entity, transform, sprite]: view.each()) {
-
-
-            auto& [width, height, sx, sy, sw, sh] = normalized_uvs[sprite.name];
-
-            bool flipX = false;
+        // Static sprites only pay for vertex math when their chunk changed
+        static_cache.update(*registry, [this](const entt::entity entity, std::vector<SpriteVertex> &vertices) {
+            vertices.resize(vertices.size() + 4);
+            write_quad(entity, registry->get<rpg::Transform>(entity).position, vertices.data() + vertices.size() - 4);
+            return get_draw_key(registry->get<Sprite>(entity));
+        });
+        update_culler();
+
+        const Vector2 screen_size = backend->get_screen_size();
+        const Rectangle visible_area = get_visible_area(*camera, screen_size.x, screen_size.y);
+        static_cache.query(visible_area, visible_chunks);
+        culler.query(visible_area, visible_entities);
+
+        for (auto &bucket: draw_buckets) {
+            bucket.static_ranges.clear();
+        }
 
-            // Flip horizontally if width is negative
-            if (width < 0) {
-                flipX = true;
-                width *= -1;
+        for (const auto *chunk: visible_chunks) {
+            for (const auto &batch: chunk->batches) {
+                draw_buckets[batch.key].static_ranges.emplace_back(chunk->vertices.data() + batch.begin, batch.count);
             }
+        }
 
-            // Adjust Y UV coordinate for vertically flipped sprites
-            if (height < 0) {
-                sy -= height;
-            }
+        build_moving_vertices();
 
-            // Destination rectangle on screen
-            const Rectangle dest = {
-                transform.position.x,
-                transform.position.y,
-                width,
-                height
-            };
-
-            // Pivot point for rotation (centered on sprite)
-            const Vector2 origin = {
-                sprite.size.x * 0.5f,
-                sprite.size.y * 0.5f
-            };
-
-            // Compute final vertex positions with rotation
-            apply_rotation(dest, origin, transform.rotation);
-
-            // UV coordinates per corner (flipped if needed)
-            const float tx[4] = {
-                flipX ? sx + sw : sx,
-                flipX ? sx + sw : sx,
-                flipX ? sx : sx + sw,
-                flipX ? sx : sx + sw
-            };
-
-            const float ty[4] = {
-                sy,
-                sy + sh,
-                sy + sh,
-                sy
-            };
-
-            // Set color and normal
-            rlColor4ub(sprite.color.r, sprite.color.g, sprite.color.b, sprite.color.a);
-            rlNormal3f(0.0f, 0.0f, 1.0f);
-
-            // Submit 4 vertices (1 quad) to the GPU
-            for (int i = 0; i < 4; ++i) {
-                rlTexCoord2f(tx[i], ty[i]);
-                rlVertex2f(verts_cache[i].x, verts_cache[i].y);
-            }
+        auto &render_stats = registry->ctx().emplace<RenderStats>();
+        render_stats.drawn_sprites = static_cast<std::uint32_t>(visible_entities.size());
+        for (const auto *chunk: visible_chunks) {
+            render_stats.drawn_sprites += static_cast<std::uint32_t>(chunk->entities.size());
         }
+        render_stats.culled_sprites = static_cache.get_sprite_count() + culler.size() - render_stats.drawn_sprites;
+        render_stats.drawn_chunks = static_cast<std::uint32_t>(visible_chunks.size());
+        render_stats.rebuilt_chunks = static_cache.get_rebuilt_chunks();
 
-        rlEnd();
-        rlSetTexture(0); // Unbind texture
+        submit_buckets(render_stats);
     }
 
 } // namespace rpg
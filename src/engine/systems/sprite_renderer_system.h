@@ -6,29 +6,87 @@
 #define SPRITE_RENDERER_SYSTEM_H
 #include "raylib.h"
 #include "system.h"
-#include <unordered_map>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
 
 #include "entt/entt.hpp"
 #include "nlohmann/json.hpp"
+#include "engine/components/components.h"
+#include "engine/render/render_backend.h"
+#include "engine/render/sprite_atlas.h"
+#include "engine/render/static_sprite_cache.h"
+#include "engine/render/view_culler.h"
 
 namespace rpg {
 
 class SpriteRendererSystem final : public System {
-    struct SpriteUV {
-        float width, height;
-        float sx, sy, sw, sh;
+    // Quads drawn with one atlas page and blend mode: the ranges of the visible static chunks,
+    // then a range of moving_vertices
+    struct DrawBucket {
+        std::vector<std::span<const SpriteVertex>> static_ranges;
+        std::uint32_t moving_begin = 0;
+        std::uint32_t moving_count = 0;
     };
-    Texture2D atlas_texture{};
+
+    // Loads the atlas pages and draws the quads
+    RenderBackend *backend;
+    // One texture per atlas page, indexed by SpriteRegion::page
+    std::vector<Texture2D> atlas_pages;
     nlohmann::json json_data;
 
-    std::unordered_map<std::string, SpriteUV> normalized_uvs;
+    // Regions of the sprites, owned by the registry context; sprites index it by handle
+    SpriteAtlas *sprite_atlas;
     bool load_resources();
-    std::array<Vector2, 4>  verts_cache{};
 
-    void apply_rotation(const Rectangle &dest, const Vector2 &origin, float rotation_deg);
+    // Sprites outside the camera's view are culled before any vertex math: static ones by chunk,
+    // moving ones one by one
+    const Camera2D *camera;
+    StaticSpriteCache static_cache;
+    ViewCuller culler;
+    std::vector<const StaticChunk *> visible_chunks;
+    std::vector<entt::entity> visible_entities;
+    // Indexed by draw key: page * BLEND_MODE_COUNT + blend mode, so every page is bound once
+    std::vector<DrawBucket> draw_buckets;
+
+    // Quads of the visible moving sprites, interleaved and grouped by draw key. The buffer only
+    // grows, so it is not reallocated once it fits the scene.
+    std::vector<SpriteVertex> moving_vertices;
+    // Draw key and quad slot in moving_vertices of each visible moving sprite
+    std::vector<std::uint32_t> moving_keys;
+    std::vector<std::uint32_t> moving_slots;
+
+    static std::array<Vector2, 4> apply_rotation(const Rectangle &dest, const Vector2 &origin, float rotation_deg);
+
+    [[nodiscard]] float get_reach(const Sprite &sprite) const;
+
+    void on_sprite_changed(entt::registry &registry, entt::entity entity);
+
+    void on_transform_changed(entt::registry &registry, entt::entity entity);
+
+    void update_culler();
+
+    [[nodiscard]] std::uint32_t get_draw_key(const Sprite &sprite) const;
+
+    void write_quad(entt::entity entity, Vector2 position, SpriteVertex *quad) const;
+
+    void build_moving_vertices();
+
+    void submit_buckets(RenderStats &render_stats) const;
 public:
-    explicit SpriteRendererSystem(entt::registry *registry);
+    SpriteRendererSystem(entt::registry *registry, const Camera2D *camera, RenderBackend *backend);
+    ~SpriteRendererSystem() override;
     void run(float dt) override;
+
+private:
+    // Blend modes a sprite can use, BLEND_ALPHA .. BLEND_CUSTOM_SEPARATE.
+    static constexpr std::uint32_t BLEND_MODE_COUNT = BLEND_CUSTOM_SEPARATE + 1;
+    // Marks that no atlas page is bound yet.
+    static constexpr std::uint32_t NO_PAGE = 0xFFFFFFFF;
+    // Vertices submitted between two starts of the backend's quad buffer: all of it, since only
+    // sprite quads go in it (default: 32768).
+    static constexpr std::uint32_t BATCH_VERTEX_CAPACITY = RenderBackend::BATCH_VERTEX_LIMIT;
 };
 
 } // rpg
@@ -4,24 +4,33 @@
 
 #include "entities_factory.h"
 #include "engine/components/components.h"
+#include "engine/render/sprite_atlas.h"
 #include "entt/entt.hpp"
 
 void rpg::create_player(entt::registry *registry, const PlayerConfig& config) {
     const auto player = registry->create();
 
-    registry->emplace<Sprite>(player,config.sprite);
+    Sprite sprite = config.sprite;
+    sprite.handle = get_sprite_handle(*registry, config.sprite_name);
+    registry->emplace<Sprite>(player, sprite);
     registry->emplace<Transform>(player, config.transform);
     registry->emplace<Input>(player, config.input);
     registry->emplace<BoxCollider2D>(player, config.collider);
-    registry->emplace<MovementData>(player,config.movement_data);
+    // Starts at rest where it spawns, so the first frames are not interpolated from the origin
+    registry->emplace<MovementData>(player,config.movement_data).previous_position = config.transform.position;
+    // Keeps the player from tunneling through thin walls at low tick rates
+    registry->emplace<ContinuousCollision>(player);
 
 }
 
 void rpg::create_enemy(entt::registry *registry, const EnemyConfig& config) {
     const auto enemy = registry->create();
-    registry->emplace<Sprite>(enemy, config.sprite);
+    Sprite sprite = config.sprite;
+    sprite.handle = get_sprite_handle(*registry, config.sprite_name);
+    registry->emplace<Sprite>(enemy, sprite);
     registry->emplace<Transform>(enemy, config.transform);
     registry->emplace<BoxCollider2D>(enemy, config.collider);
-    registry->emplace<MovementData>(enemy, config.movement_data);
+    registry->emplace<MovementData>(enemy, config.movement_data).previous_position = config.transform.position;
+    registry->emplace<FlowFieldAgent>(enemy);
 
 }
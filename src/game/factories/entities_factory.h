@@ -1,23 +1,41 @@
 #ifndef ENTITIES_FACTORY_H
 #define ENTITIES_FACTORY_H
+#include <cstdint>
+#include <string>
+
 #include "engine/components/components.h"
 namespace rpg {
 
+    // Collision layers of the game's colliders, see BoxCollider2D::layer and BoxCollider2D::mask
+    namespace collision_layers {
+        constexpr std::uint32_t PLAYER = 1u << 0;
+        constexpr std::uint32_t ENEMY = 1u << 1;
+        constexpr std::uint32_t ENVIRONMENT = 1u << 2;
+        constexpr std::uint32_t PLAYER_PROJECTILE = 1u << 3;
+        constexpr std::uint32_t ENEMY_PROJECTILE = 1u << 4;
+    } // namespace collision_layers
+
     struct PlayerConfig {
         //ColorRect color_rect{ Color(30, 200, 25, 255), 50.f, 50.f };
-        Sprite sprite{"player.png", Vector2{10,10}, RAYWHITE };
+        // Resolved into sprite.handle when the player is spawned
+        std::string sprite_name = "player.png";
+        Sprite sprite{EMPTY_SPRITE, Vector2{10,10}, RAYWHITE };
         Transform transform{ {0.f, 0.f}, 0.f, {1.f, 1.f} };
         Input input{ {0.f, 0.f} };
-        BoxCollider2D collider{ 30.f, 30.f, false, false, false, true };
+        BoxCollider2D collider{ 30.f, 30.f, false, false, false, true, collision_layers::PLAYER,
+            collision_layers::ENEMY | collision_layers::ENVIRONMENT | collision_layers::ENEMY_PROJECTILE };
         MovementData movement_data{ {0.f, 0.f}, 300.f, {0.f, 0.f} };
     };
 
     void create_player(entt::registry* registry, const PlayerConfig& config);
 
     struct EnemyConfig {
-        Sprite sprite{"enemy.png", Vector2{10,10}, RAYWHITE };
+        // Resolved into sprite.handle when the enemy is spawned
+        std::string sprite_name = "enemy.png";
+        Sprite sprite{EMPTY_SPRITE, Vector2{10,10}, RAYWHITE };
         Transform transform{ {0.f, 0.f}, 0.f, {1.f, 1.f} };
-        BoxCollider2D collider{ 60.f, 60.f, false, false, true, true };
+        BoxCollider2D collider{ 60.f, 60.f, false, false, true, true, collision_layers::ENEMY,
+            collision_layers::PLAYER | collision_layers::ENEMY | collision_layers::ENVIRONMENT | collision_layers::PLAYER_PROJECTILE };
         MovementData movement_data{ {0.f, 0.f}, 300.f, {0.f, 0.f} };
     };
 
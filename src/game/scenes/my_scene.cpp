@@ -3,6 +3,7 @@
 #include "my_scene.h"
 #include <random>
 #include "engine/components/components.h"
+#include "engine/render/sprite_atlas.h"
 
 #include "game/factories/entities_factory.h"
 #include "engine/scenes/scene.h"
@@ -25,6 +26,8 @@ void rpg::MyScene::init() {
     std::uniform_int_distribution distColor(100, 255);
     std::uniform_int_distribution<> dis(0, 1);
 
+    registry->ctx().insert_or_assign(WorldBounds{{0.f, 0.f, MAP_WIDTH, MAP_HEIGHT}});
+
     PlayerConfig player_config;
     player_config.transform.scale = Vector2(1.f,1.f);
     player_config.transform.position = {100.f, 200.f};
@@ -34,18 +37,18 @@ void rpg::MyScene::init() {
     enemy_config.collider.width = ENEMY_SIZE;
     enemy_config.collider.height = ENEMY_SIZE;
     enemy_config.collider.is_static = false;
-    enemy_config.sprite.name = "sprite.png";
+    enemy_config.sprite_name = "sprite.png";
 
     for (int i = 0; i < ENEMY_QUANTITY; ++i) {
         float x = distX(gen);
         float y = distY(gen);
         enemy_config.transform.position = {x, y};
         if (dis(gen) == 1) {
-            enemy_config.sprite.name = "sprite.png";
+            enemy_config.sprite_name = "sprite.png";
             enemy_config.collider.width = 30.f;
             enemy_config.collider.height = 30.f;
         }else {
-            enemy_config.sprite.name = "enemy.png";
+            enemy_config.sprite_name = "enemy.png";
             enemy_config.collider.width = 60.f;
             enemy_config.collider.height = 60.f;
         }
@@ -58,7 +61,8 @@ void rpg::MyScene::init() {
         create_enemy(registry, enemy_config);
     }
 
-    Sprite sprite{"enemy.png", Vector2{10,10}, RAYWHITE };
+    // Resolved once for the whole environment
+    Sprite sprite{get_sprite_handle(*registry, "enemy.png"), Vector2{10,10}, RAYWHITE };
     Transform transform{ {0.f, 0.f}, 0.f, {1.f, 1.f} };
 
 
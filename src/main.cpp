@@ -1,7 +1,21 @@
+#include <cstdlib>
+#include <string_view>
+
 #include "engine/app.h"
 
-int main() {
-    const rpg::APP app;
+// Usage: raylib_game [--headless [--frames N]]
+int main(const int argc, char **argv) {
+    rpg::AppConfig config;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view argument = argv[i];
+        if (argument == "--headless") {
+            config.headless = true;
+        } else if (argument == "--frames" && i + 1 < argc) {
+            config.headless_frames = std::strtoull(argv[++i], nullptr, 10);
+        }
+    }
+
+    const rpg::APP app(config);
     app.run();
     return 0;
-}
\ No newline at end of file
+}
@@ -25,6 +25,13 @@ struct PackedImage {
 
 namespace fs = std::filesystem;
 
+std::string TexturePacker::get_page_path(const std::string &atlasPath, const int page) {
+    if (page == 0) return atlasPath;
+
+    const fs::path path(atlasPath);
+    return (path.parent_path() / (path.stem().string() + "_" + std::to_string(page) + path.extension().string())).string();
+}
+
 void TexturePacker::packer(
     const std::string &inputDir,
     const std::string &outputAtlas,
@@ -49,31 +56,59 @@ void TexturePacker::packer(
         return;
     }
 
-    // 2. Prepare rectangles for packing
-    std::vector<stbrp_rect> rects(images.size());
+    // 2. Prepare rectangles for packing; images larger than a page can never be packed
+    std::vector<stbrp_rect> pending;
     for (size_t i = 0; i < images.size(); ++i) {
-        rects[i].id = i;
-        rects[i].w = images[i].width + MARGIN * 2;
-        rects[i].h = images[i].height + MARGIN * 2;
+        stbrp_rect rect{};
+        rect.id = i;
+        rect.w = images[i].width + MARGIN * 2;
+        rect.h = images[i].height + MARGIN * 2;
+
+        if (rect.w > ATLAS_WIDTH || rect.h > ATLAS_HEIGHT) {
+            std::cerr << "Image does not fit in an atlas page: " << images[i].name << "\n";
+            continue;
+        }
+        pending.push_back(rect);
     }
 
-    // 3. Initialize the rectangle packer
+    // 3. Fill one page per pass with the rectangles that still fit; the rest go to the next page
+    struct PlacedRect {
+        stbrp_rect rect;
+        int page;
+    };
+    std::vector<PlacedRect> placed;
+    int page_count = 0;
+
     const int NUM_NODES = ATLAS_WIDTH;
     std::vector<stbrp_node> nodes(NUM_NODES);
-    stbrp_context context;
-    stbrp_init_target(&context, ATLAS_WIDTH, ATLAS_HEIGHT, nodes.data(), NUM_NODES);
+    while (!pending.empty()) {
+        stbrp_context context;
+        stbrp_init_target(&context, ATLAS_WIDTH, ATLAS_HEIGHT, nodes.data(), NUM_NODES);
+        stbrp_pack_rects(&context, pending.data(), (int) pending.size());
+
+        std::vector<stbrp_rect> remaining;
+        for (const auto &rect: pending) {
+            if (rect.was_packed) {
+                placed.push_back({rect, page_count});
+            } else {
+                remaining.push_back(rect);
+            }
+        }
 
-    if (!stbrp_pack_rects(&context, rects.data(), (int) rects.size())) {
-        std::cerr << "Error: could not pack all images into the atlas.\n";
-        return;
+        if (remaining.size() == pending.size()) {
+            std::cerr << "Error: could not pack the remaining images into a new page.\n";
+            break;
+        }
+        pending.swap(remaining);
+        ++page_count;
     }
 
-    // 4. Create buffer for the atlas
-    std::vector<unsigned char> atlas(ATLAS_WIDTH * ATLAS_HEIGHT * 4, 0);
+    // 4. Create one buffer per page
+    std::vector<std::vector<unsigned char>> pages(page_count, std::vector<unsigned char>(ATLAS_WIDTH * ATLAS_HEIGHT * 4, 0));
 
-    // 5. Copy image pixels into the atlas
+    // 5. Copy image pixels into their page
     nlohmann::json atlasJson;
-    for (const auto &rect: rects) {
+    for (const auto &[rect, page]: placed) {
         const PackedImage &img = images[rect.id];
         int dstX = rect.x + MARGIN;
         int dstY = rect.y + MARGIN;
@@ -82,7 +117,7 @@ void TexturePacker::packer(
             for (int x = 0; x < img.width; ++x) {
                 int srcIdx = (y * img.width + x) * 4;
                 int dstIdx = ((dstY + y) * ATLAS_WIDTH + (dstX + x)) * 4;
-                std::memcpy(&atlas[dstIdx], &img.pixels[srcIdx], 4);
+                std::memcpy(&pages[page][dstIdx], &img.pixels[srcIdx], 4);
             }
         }
 
@@ -91,13 +126,17 @@ void TexturePacker::packer(
             {"x", dstX},
             {"y", dstY},
             {"width", img.width},
-            {"height", img.height}
+            {"height", img.height},
+            {"page", page}
         };
     }
 
-    // 6. Save atlas as PNG
-    if (!stbi_write_png(outputAtlas.c_str(), ATLAS_WIDTH, ATLAS_HEIGHT, 4, atlas.data(), ATLAS_WIDTH * 4)) {
-        std::cerr << "Failed to save atlas as PNG.\n";
+    // 6. Save every page as PNG
+    for (int page = 0; page < page_count; ++page) {
+        const std::string page_path = get_page_path(outputAtlas, page);
+        if (!stbi_write_png(page_path.c_str(), ATLAS_WIDTH, ATLAS_HEIGHT, 4, pages[page].data(), ATLAS_WIDTH * 4)) {
+            std::cerr << "Failed to save atlas page as PNG: " << page_path << "\n";
+        }
     }
 
     // 7. Save JSON
@@ -114,5 +153,5 @@ void TexturePacker::packer(
         stbi_image_free(img.pixels);
     }
 
-    std::cout << "Atlas successfully generated!\n";
+    std::cout << "Atlas successfully generated with " << page_count << " page(s)!\n";
 }
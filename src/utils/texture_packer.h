@@ -16,11 +16,16 @@ public:
 
     ~TexturePacker() = default;
 
+    // Packs the images into as many pages as needed. Page 0 is written to outputAtlas and the
+    // others next to it (see get_page_path); every JSON entry records the page of its image.
     void packer(
     const std::string &inputDir,
     const std::string &outputAtlas,
     const std::string &outputJson) const;
 
+    // Path of an atlas page: the atlas path itself for page 0, "<stem>_<page><ext>" for the others
+    static std::string get_page_path(const std::string &atlasPath, int page);
+
 };
 
 